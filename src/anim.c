@@ -0,0 +1,329 @@
+#include "raylib.h"
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#include "main.h"
+#include "anim.h"
+
+_Static_assert(ANIM_TRACK_COUNT == LEG_COUNT, "one animation track per leg segment");
+
+size_t anim_memory_size(int character_count)
+{
+    return ANIM_MAX_CLIPS * sizeof(Anim_Clip) + (size_t)character_count * sizeof(Anim_Instance)
+        + sizeof(Anim_Capture) + 3 * 16;
+}
+
+bool anim_init(Anim_System* a, Arena* level, int character_count)
+{
+    *a = (Anim_System) {0};
+    a->clips = ARENA_PUSH_ARRAY(level, Anim_Clip, ANIM_MAX_CLIPS);
+    a->instances = ARENA_PUSH_ARRAY(level, Anim_Instance, character_count);
+    a->capture = ARENA_PUSH_ARRAY(level, Anim_Capture, 1);
+    if (a->clips == NULL || a->instances == NULL || a->capture == NULL) return false;
+
+    a->instance_count = character_count;
+    for (int i = 0; i < character_count; i++) a->instances[i] = (Anim_Instance) {.clip = -1};
+    a->capture->character = -1;
+    return true;
+}
+
+int anim_add_clip(Anim_System* a, const Anim_Clip* clip)
+{
+    if (a->clip_count >= ANIM_MAX_CLIPS) return -1;
+    a->clips[a->clip_count] = *clip;
+    return a->clip_count++;
+}
+
+// Value the decoder produces between two quantised keys, in degrees.
+static float lerp_quantized(uint16_t v0, uint16_t v1, float t)
+{
+    int16_t d = (int16_t)(uint16_t)(v1 - v0);
+    return ((float)v0 + (float)d * t) * (360.0f / 65536.0f);
+}
+
+static float angle_error(float a, float b)
+{
+    float d = fmodf(a - b, 360.0f);
+    if (d > 180.0f) d -= 360.0f;
+    if (d < -180.0f) d += 360.0f;
+    return fabsf(d);
+}
+
+// samples is sample_count rows of ANIM_TRACK_COUNT rotations in degrees. Each
+// track is reduced greedily: from the last kept key, the next key is the
+// furthest sample such that every sample in between is reproduced within
+// tolerance degrees. Returns false if the reduced clip does not fit.
+bool anim_compress(Anim_Clip* clip, const float* samples, int sample_count, float sample_rate, float tolerance)
+{
+    if (sample_count < 2 || sample_count > UINT16_MAX) return false;
+
+    *clip = (Anim_Clip) {
+        .magic = ANIM_MAGIC,
+        .version = ANIM_VERSION,
+        .sample_rate = sample_rate,
+        .sample_count = (uint16_t)sample_count,
+    };
+    int n = 0;
+    for (int tr = 0; tr < ANIM_TRACK_COUNT; tr++) {
+        clip->track_first[tr] = (uint16_t)n;
+        int key = 0;
+        while (true) {
+            if (n >= ANIM_MAX_KEYS) return false;
+            clip->key_time[n] = (uint16_t)key;
+            clip->key_value[n] = anim_quantize(samples[key * ANIM_TRACK_COUNT + tr]);
+            n++;
+            if (key == sample_count - 1) break;
+
+            int next = key + 1;
+            for (int cand = key + 2; cand < sample_count; cand++) {
+                uint16_t v0 = anim_quantize(samples[key * ANIM_TRACK_COUNT + tr]);
+                uint16_t v1 = anim_quantize(samples[cand * ANIM_TRACK_COUNT + tr]);
+                bool fits = true;
+                for (int s = key + 1; s < cand && fits; s++) {
+                    float t = (float)(s - key) / (float)(cand - key);
+                    fits = angle_error(lerp_quantized(v0, v1, t), samples[s * ANIM_TRACK_COUNT + tr]) <= tolerance;
+                }
+                if (!fits) break;
+                next = cand;
+            }
+            key = next;
+        }
+        clip->track_keys[tr] = (uint16_t)(n - clip->track_first[tr]);
+    }
+    clip->key_count = (uint16_t)n;
+    return true;
+}
+
+void anim_play(World* w, int character, int clip, float speed)
+{
+    Anim_System* a = &w->anim;
+    if (character < 0 || character >= a->instance_count || clip < 0 || clip >= a->clip_count) return;
+    Anim_Instance* inst = &a->instances[character];
+    if (inst->clip < 0) a->active_count++;
+    *inst = (Anim_Instance) {.clip = clip, .time = 0.0f, .speed = speed};
+}
+
+// Stopping drops the clip's blend weight; the legs keep their last pose.
+void anim_stop(World* w, int character)
+{
+    Anim_System* a = &w->anim;
+    if (character < 0 || character >= a->instance_count) return;
+    if (a->instances[character].clip >= 0) a->active_count--;
+    a->instances[character].clip = -1;
+    int first_leg = w->characters[character].first_leg;
+    for (int tr = 0; tr < ANIM_TRACK_COUNT; tr++) {
+        w->blend.weight[BLEND_ANIM][first_leg + tr] = 0.0f;
+    }
+}
+
+// Writes n rotations: out[i] = dequantize(v0[i] + dv[i] * t[i]).
+static void decode_batch(float* out, const int32_t* v0, const int32_t* dv, const float* t, int n)
+{
+    const float scale = 360.0f / 65536.0f;
+    int i = 0;
+#if defined(__SSE2__)
+    __m128 vscale = _mm_set1_ps(scale);
+    for (; i + 4 <= n; i += 4) {
+        __m128 a = _mm_cvtepi32_ps(_mm_loadu_si128((const __m128i*)(v0 + i)));
+        __m128 d = _mm_cvtepi32_ps(_mm_loadu_si128((const __m128i*)(dv + i)));
+        __m128 r = _mm_add_ps(a, _mm_mul_ps(d, _mm_loadu_ps(t + i)));
+        _mm_storeu_ps(out + i, _mm_mul_ps(r, vscale));
+    }
+#endif
+    for (; i < n; i++) {
+        out[i] = ((float)v0[i] + (float)dv[i] * t[i]) * scale;
+    }
+}
+
+void anim_sample(World* w, float dt)
+{
+    Anim_System* a = &w->anim;
+    if (a->active_count == 0) return;
+
+    size_t mark = arena_mark(w->scratch);
+    int cap = a->active_count * ANIM_TRACK_COUNT;
+    int32_t* v0 = ARENA_PUSH_ARRAY(w->scratch, int32_t, cap);
+    int32_t* dv = ARENA_PUSH_ARRAY(w->scratch, int32_t, cap);
+    float* t = ARENA_PUSH_ARRAY(w->scratch, float, cap);
+    int32_t* leg = ARENA_PUSH_ARRAY(w->scratch, int32_t, cap);
+    float* out = ARENA_PUSH_ARRAY(w->scratch, float, cap);
+    if (v0 == NULL || dv == NULL || t == NULL || leg == NULL || out == NULL) {
+        arena_rewind(w->scratch, mark);
+        return;
+    }
+
+    // Gather: advance each instance and find its bracketing keys.
+    int n = 0;
+    for (int c = 0; c < a->instance_count && n < cap; c++) {
+        Anim_Instance* inst = &a->instances[c];
+        if (inst->clip < 0) continue;
+        const Anim_Clip* clip = &a->clips[inst->clip];
+        float length = (float)(clip->sample_count - 1);
+
+        inst->time += dt * inst->speed * clip->sample_rate;
+        if (inst->time >= length) {
+            inst->time = fmodf(inst->time, length);
+            memset(inst->cursor, 0, sizeof(inst->cursor));
+        }
+        // Clip time always advances; lower LOD tiers only resample on their frames.
+        if (!lod_due(&w->lod, c)) continue;
+        float frame = inst->time;
+        int first_leg = w->characters[c].first_leg;
+
+        for (int tr = 0; tr < ANIM_TRACK_COUNT; tr++) {
+            const uint16_t* times = &clip->key_time[clip->track_first[tr]];
+            const uint16_t* values = &clip->key_value[clip->track_first[tr]];
+            int keys = clip->track_keys[tr];
+            int k = inst->cursor[tr];
+            while (k + 1 < keys && (float)times[k + 1] <= frame) k++;
+            inst->cursor[tr] = (uint16_t)k;
+
+            v0[n] = values[k];
+            if (k + 1 < keys) {
+                dv[n] = (int16_t)(uint16_t)(values[k + 1] - values[k]);
+                t[n] = (frame - (float)times[k]) / (float)(times[k + 1] - times[k]);
+            } else {
+                dv[n] = 0;
+                t[n] = 0.0f;
+            }
+            leg[n] = first_leg + tr;
+            n++;
+        }
+    }
+
+    decode_batch(out, v0, dv, t, n);
+    for (int i = 0; i < n; i++) {
+        blend_set(&w->blend, BLEND_ANIM, leg[i], out[i], 1.0f);
+    }
+    arena_rewind(w->scratch, mark);
+}
+
+void anim_capture_begin(Anim_System* a, int character)
+{
+    a->capture->character = character;
+    a->capture->frame_count = 0;
+}
+
+void anim_capture_frame(Anim_System* a, const World* w)
+{
+    Anim_Capture* cap = a->capture;
+    if (cap->character < 0 || cap->frame_count >= ANIM_CAPTURE_FRAMES) return;
+    int first_leg = w->characters[cap->character].first_leg;
+    for (int tr = 0; tr < ANIM_TRACK_COUNT; tr++) {
+        cap->frames[cap->frame_count][tr] = w->legs[first_leg + tr].rotation;
+    }
+    cap->frame_count++;
+}
+
+// Compresses the captured frames into a new clip. Returns its index, or -1.
+int anim_capture_end(Anim_System* a)
+{
+    Anim_Capture* cap = a->capture;
+    int frames = cap->frame_count;
+    cap->character = -1;
+
+    Anim_Clip clip;
+    if (!anim_compress(&clip, &cap->frames[0][0], frames, 60.0f, ANIM_DEFAULT_TOLERANCE)) return -1;
+    return anim_add_clip(a, &clip);
+}
+
+// A one second authored kick: wind the thigh back, snap the shin through and
+// flick the foot, then return to rest.
+int anim_add_kick_clip(Anim_System* a)
+{
+    enum { KICK_SAMPLES = 61 };
+    float samples[KICK_SAMPLES][ANIM_TRACK_COUNT];
+    for (int s = 0; s < KICK_SAMPLES; s++) {
+        float p = (float)s / (KICK_SAMPLES - 1);
+        samples[s][0] = -35.0f * sinf(PI * p);
+        samples[s][1] = 50.0f * sinf(2.0f * PI * p) * (1.0f - p);
+        samples[s][2] = 20.0f * sinf(PI * p * p);
+    }
+    Anim_Clip clip;
+    if (!anim_compress(&clip, &samples[0][0], KICK_SAMPLES, 60.0f, ANIM_DEFAULT_TOLERANCE)) return -1;
+    return anim_add_clip(a, &clip);
+}
+
+bool anim_clip_save(const Anim_Clip* clip, const char* path)
+{
+    FILE* f = fopen(path, "wb");
+    if (f == NULL) return false;
+    bool ok = fwrite(clip, sizeof(*clip), 1, f) == 1;
+    return fclose(f) == 0 && ok;
+}
+
+// Whether anim_sample can play the clip: a track must have at least one key
+// and stay inside the key arrays, and its key times must rise strictly and
+// stay inside the clip, or the interpolation divides by zero. The clip must
+// also advance at a finite, positive rate.
+static bool clip_valid(const Anim_Clip* clip)
+{
+    if (clip->magic != ANIM_MAGIC || clip->version != ANIM_VERSION || clip->key_count > ANIM_MAX_KEYS) return false;
+    if (clip->sample_count < 2 || !isfinite(clip->sample_rate) || clip->sample_rate <= 0.0f) return false;
+    for (int tr = 0; tr < ANIM_TRACK_COUNT; tr++) {
+        int first = clip->track_first[tr], keys = clip->track_keys[tr];
+        if (keys == 0 || first + keys > clip->key_count) return false;
+        for (int k = 0; k < keys; k++) {
+            if (clip->key_time[first + k] >= clip->sample_count) return false;
+            if (k > 0 && clip->key_time[first + k] <= clip->key_time[first + k - 1]) return false;
+        }
+    }
+    return true;
+}
+
+bool anim_clip_load(Anim_Clip* clip, const char* path)
+{
+    FILE* f = fopen(path, "rb");
+    if (f == NULL) return false;
+    bool ok = fread(clip, sizeof(*clip), 1, f) == 1;
+    fclose(f);
+    return ok && clip_valid(clip);
+}
+
+// Writes the authored kick clip broken in one way to a file and expects
+// anim_clip_load to refuse it.
+static bool check_rejected(const char* name, const Anim_Clip* clip)
+{
+    Anim_Clip loaded;
+    bool rejected = anim_clip_save(clip, ANIM_SELF_TEST_FILE) && !anim_clip_load(&loaded, ANIM_SELF_TEST_FILE);
+    printf("anim: clip with %-24s %s\n", name, rejected ? "rejected" : "LOADED");
+    return rejected;
+}
+
+// Round-trips the authored kick clip through the loader, then checks that
+// the loader refuses clips anim_sample cannot play.
+bool anim_self_test(void)
+{
+    static Anim_System a;
+    static Anim_Clip clips[1];
+    a = (Anim_System) {.clips = clips};
+    Anim_Clip loaded;
+    if (anim_add_kick_clip(&a) < 0 || !anim_clip_save(&clips[0], ANIM_SELF_TEST_FILE)
+        || !anim_clip_load(&loaded, ANIM_SELF_TEST_FILE) || memcmp(&loaded, &clips[0], sizeof(loaded)) != 0) {
+        printf("anim: kick clip did not survive a save and load FAILED\n");
+        remove(ANIM_SELF_TEST_FILE);
+        return false;
+    }
+    bool ok = true;
+
+    Anim_Clip c = clips[0];
+    int k = clips[0].track_first[1] + 1;
+    c.key_time[k] = c.key_time[k - 1];
+    ok = check_rejected("repeated key time", &c) && ok;
+
+    c = clips[0];
+    c.key_time[clips[0].track_first[0] + clips[0].track_keys[0] - 1] = c.sample_count;
+    ok = check_rejected("key past the last sample", &c) && ok;
+
+    c = clips[0];
+    c.sample_rate = NAN;
+    ok = check_rejected("NaN sample rate", &c) && ok;
+    c.sample_rate = 0.0f;
+    ok = check_rejected("zero sample rate", &c) && ok;
+
+    remove(ANIM_SELF_TEST_FILE);
+    return ok;
+}
@@ -0,0 +1,99 @@
+#ifndef ANIM_H
+#define ANIM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <math.h>
+#include "arena.h"
+
+// Keyframed leg animation. A clip holds one rotation track per leg segment.
+// Rotations are stored as 16-bit turns (65536 = 360 degrees), which wrap the
+// same way angles do, and each track keeps only the keys that linear
+// interpolation cannot reproduce within the tolerance given to anim_compress.
+// Key times are sample indices at the clip's sample rate. Every clip has the
+// same fixed footprint, sizeof(Anim_Clip).
+//
+// Playback is streamed: each instance keeps a per-track cursor that only
+// moves forward, so finding the bracketing keys is amortised O(1). Sampling
+// gathers every active instance's key pair into flat arrays and then
+// dequantises and interpolates them in one vectorised pass.
+//
+// anim_clip_load refuses a clip anim_sample could not play: repeated or
+// out-of-range key times, or a sample rate that is not finite and positive.
+// anim_self_test checks that with broken copies of the kick clip; run it
+// with --self-test.
+
+#define ANIM_MAX_KEYS 256
+#define ANIM_TRACK_COUNT 3
+#define ANIM_MAX_CLIPS 16
+#define ANIM_MAGIC 0x4d494e41u // "ANIM"
+#define ANIM_VERSION 1
+#define ANIM_DEFAULT_TOLERANCE 0.25f
+#define ANIM_CAPTURE_FRAMES 600
+#define ANIM_CAPTURE_FILE "maradonna_capture.anim"
+#define ANIM_SELF_TEST_FILE "maradonna_self_test.anim"
+
+typedef struct anim_clip {
+    uint32_t magic;
+    uint32_t version;
+    float sample_rate;
+    uint16_t sample_count;
+    uint16_t key_count;
+    uint16_t track_first[ANIM_TRACK_COUNT];
+    uint16_t track_keys[ANIM_TRACK_COUNT];
+    uint16_t key_time[ANIM_MAX_KEYS];
+    uint16_t key_value[ANIM_MAX_KEYS];
+} Anim_Clip;
+
+typedef struct anim_instance {
+    int clip;
+    float time;
+    float speed;
+    uint16_t cursor[ANIM_TRACK_COUNT];
+} Anim_Instance;
+
+typedef struct anim_capture {
+    int character;
+    int frame_count;
+    float frames[ANIM_CAPTURE_FRAMES][ANIM_TRACK_COUNT];
+} Anim_Capture;
+
+typedef struct anim_system {
+    Anim_Clip* clips;
+    int clip_count;
+    Anim_Instance* instances;
+    int instance_count;
+    int active_count;
+    Anim_Capture* capture;
+} Anim_System;
+
+struct world;
+
+static inline uint16_t anim_quantize(float degrees)
+{
+    float turns = degrees * (1.0f / 360.0f);
+    turns -= floorf(turns);
+    return (uint16_t)(int)(turns * 65536.0f + 0.5f);
+}
+
+static inline float anim_dequantize(uint16_t q)
+{
+    return (float)q * (360.0f / 65536.0f);
+}
+
+size_t anim_memory_size(int character_count);
+bool anim_init(Anim_System* a, Arena* level, int character_count);
+int anim_add_clip(Anim_System* a, const Anim_Clip* clip);
+bool anim_compress(Anim_Clip* clip, const float* samples, int sample_count, float sample_rate, float tolerance);
+void anim_play(struct world* w, int character, int clip, float speed);
+void anim_stop(struct world* w, int character);
+void anim_sample(struct world* w, float dt);
+void anim_capture_begin(Anim_System* a, int character);
+void anim_capture_frame(Anim_System* a, const struct world* w);
+int anim_capture_end(Anim_System* a);
+int anim_add_kick_clip(Anim_System* a);
+bool anim_clip_save(const Anim_Clip* clip, const char* path);
+bool anim_clip_load(Anim_Clip* clip, const char* path);
+bool anim_self_test(void);
+
+#endif
@@ -0,0 +1,44 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include "arena.h"
+
+bool arena_init(Arena* a, const char* name, size_t capacity)
+{
+    a->name = name;
+    a->base = malloc(capacity);
+    a->capacity = a->base != NULL ? capacity : 0;
+    a->used = 0;
+    a->high_water = 0;
+    return a->base != NULL;
+}
+
+void arena_release(Arena* a)
+{
+    free(a->base);
+    a->base = NULL;
+    a->capacity = 0;
+    a->used = 0;
+}
+
+void* arena_alloc(Arena* a, size_t size, size_t align)
+{
+    uintptr_t p = (uintptr_t)(a->base + a->used);
+    uintptr_t aligned = (p + (align - 1)) & ~(uintptr_t)(align - 1);
+    size_t end = (size_t)(aligned - (uintptr_t)a->base) + size;
+    if (end > a->capacity) {
+#ifdef ARENA_DEBUG
+        fprintf(stderr, "arena %s: out of memory (%zu of %zu bytes used, %zu requested)\n",
+            a->name, a->used, a->capacity, size);
+#endif
+        return NULL;
+    }
+    a->used = end;
+    if (end > a->high_water) a->high_water = end;
+    return (void*)aligned;
+}
+
+void arena_report(const Arena* a, FILE* f)
+{
+    fprintf(f, "arena %-8s high water %10zu / %10zu bytes (%.1f%%)\n", a->name, a->high_water, a->capacity,
+        a->capacity ? 100.0 * (double)a->high_water / (double)a->capacity : 0.0);
+}
@@ -0,0 +1,44 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+// Linear bump allocator over one block reserved up front. Allocation is a
+// pointer bump, freeing is arena_reset (everything) or arena_rewind (back to
+// a saved arena_mark). Exhaustion returns NULL; nothing here calls malloc
+// after arena_init.
+
+typedef struct arena {
+    const char* name;
+    unsigned char* base;
+    size_t capacity;
+    size_t used;
+    size_t high_water;
+} Arena;
+
+bool arena_init(Arena* a, const char* name, size_t capacity);
+void arena_release(Arena* a);
+void* arena_alloc(Arena* a, size_t size, size_t align);
+void arena_report(const Arena* a, FILE* f);
+
+static inline void arena_reset(Arena* a)
+{
+    a->used = 0;
+}
+
+static inline size_t arena_mark(const Arena* a)
+{
+    return a->used;
+}
+
+static inline void arena_rewind(Arena* a, size_t mark)
+{
+    a->used = mark;
+}
+
+#define ARENA_PUSH_ARRAY(a, type, count) \
+    ((type*)arena_alloc((a), sizeof(type) * (size_t)(count), __alignof__(type)))
+
+#endif
@@ -0,0 +1,88 @@
+#include "raylib.h"
+#include <math.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#include "main.h"
+#include "blend.h"
+
+// How strongly IK overrides the clip on thigh, leg and foot.
+const float blend_ik_segment_weight[LEG_COUNT] = {1.0f, 1.0f, 1.0f};
+
+size_t blend_memory_size(int leg_count)
+{
+    return (size_t)leg_count * sizeof(float) * (2 * BLEND_SOURCE_COUNT + 1) + (2 * BLEND_SOURCE_COUNT + 1) * 16;
+}
+
+bool blend_init(Blend_Layers* b, Arena* level, int leg_count)
+{
+    *b = (Blend_Layers) {.leg_count = leg_count};
+    b->pose = ARENA_PUSH_ARRAY(level, float, leg_count);
+    if (b->pose == NULL) return false;
+    for (int s = 0; s < BLEND_SOURCE_COUNT; s++) {
+        b->rotation[s] = ARENA_PUSH_ARRAY(level, float, leg_count);
+        b->weight[s] = ARENA_PUSH_ARRAY(level, float, leg_count);
+        if (b->rotation[s] == NULL || b->weight[s] == NULL) return false;
+        for (int i = 0; i < leg_count; i++) {
+            b->rotation[s][i] = 0.0f;
+            b->weight[s][i] = 0.0f;
+        }
+    }
+    return true;
+}
+
+static inline float wrap180(float d)
+{
+    return d - 360.0f * rintf(d * (1.0f / 360.0f));
+}
+
+void blend_poses(World* w, float dt)
+{
+    Blend_Layers* b = &w->blend;
+    const float fade = BLEND_FADE_RATE * dt;
+    const float* la = b->rotation[BLEND_ANIM];
+    const float* li = b->rotation[BLEND_IK];
+    float* lm = b->rotation[BLEND_MANUAL];
+    const float* wa = b->weight[BLEND_ANIM];
+    float* wi = b->weight[BLEND_IK];
+    float* wm = b->weight[BLEND_MANUAL];
+    float* pose = b->pose;
+    int n = w->leg_count;
+    int i = 0;
+
+    for (int k = 0; k < n; k++) pose[k] = w->legs[k].rotation;
+
+#if defined(__SSE2__)
+    const __m128 inv360 = _mm_set1_ps(1.0f / 360.0f);
+    const __m128 c360 = _mm_set1_ps(360.0f);
+    const __m128 vfade = _mm_set1_ps(fade);
+    const __m128 zero = _mm_setzero_ps();
+    // _mm_cvtps_epi32 rounds to nearest under the default MXCSR mode.
+    #define WRAP180(d) _mm_sub_ps((d), _mm_mul_ps(c360, _mm_cvtepi32_ps(_mm_cvtps_epi32(_mm_mul_ps((d), inv360)))))
+    for (; i + 4 <= n; i += 4) {
+        __m128 r = _mm_loadu_ps(pose + i);
+        __m128 vwi = _mm_loadu_ps(wi + i);
+        __m128 vwm = _mm_loadu_ps(wm + i);
+        r = _mm_add_ps(r, _mm_mul_ps(_mm_loadu_ps(wa + i), WRAP180(_mm_sub_ps(_mm_loadu_ps(la + i), r))));
+        r = _mm_add_ps(r, _mm_mul_ps(vwi, WRAP180(_mm_sub_ps(_mm_loadu_ps(li + i), r))));
+        r = _mm_add_ps(r, _mm_mul_ps(vwm, _mm_loadu_ps(lm + i)));
+        _mm_storeu_ps(lm + i, zero);
+        _mm_storeu_ps(wi + i, _mm_max_ps(zero, _mm_sub_ps(vwi, vfade)));
+        _mm_storeu_ps(wm + i, _mm_max_ps(zero, _mm_sub_ps(vwm, vfade)));
+        _mm_storeu_ps(pose + i, r);
+    }
+    #undef WRAP180
+#endif
+    for (; i < n; i++) {
+        float r = pose[i];
+        r += wa[i] * wrap180(la[i] - r);
+        r += wi[i] * wrap180(li[i] - r);
+        r += wm[i] * lm[i];
+        lm[i] = 0.0f;
+        wi[i] = fmaxf(0.0f, wi[i] - fade);
+        wm[i] = fmaxf(0.0f, wm[i] - fade);
+        pose[i] = r;
+    }
+
+    for (int k = 0; k < n; k++) w->legs[k].rotation = pose[k];
+}
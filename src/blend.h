@@ -0,0 +1,57 @@
+#ifndef BLEND_H
+#define BLEND_H
+
+#include <stdbool.h>
+#include "arena.h"
+
+// Pose blending. Animation, IK and manual rotation each write into their own
+// layer: one rotation and one weight per leg, in flat arrays indexed like
+// World.legs. blend_poses then starts from each leg's current rotation and
+// moves it toward the ANIM and IK targets in turn by their weights, taking
+// the short way round the circle, and adds the MANUAL layer last as a delta:
+//
+//     r = r + weight[s] * wrap180(layer[s] - r)     for s = ANIM, IK
+//     r = r + weight[MANUAL] * layer[MANUAL]
+//
+// so IK sits on top of a playing clip and the mouse nudges whatever the two
+// produced. The manual delta is used up by the step that applies it. Sources
+// re-assert their weight every step they are active; IK and manual weights
+// fade out at BLEND_FADE_RATE per second once the source stops, easing back
+// to the clip.
+//
+// Leg rotations live in the 32-byte Leg_Element records, so blend_poses
+// first copies them into the flat pose array, blends that alongside the
+// layers with whole-vector loads and stores, and copies the result back
+// once.
+
+#define BLEND_FADE_RATE 6.0f
+
+typedef enum blend_source {
+    BLEND_ANIM,
+    BLEND_IK,
+    BLEND_MANUAL,
+    BLEND_SOURCE_COUNT
+} Blend_Source;
+
+typedef struct blend_layers {
+    float* rotation[BLEND_SOURCE_COUNT];
+    float* weight[BLEND_SOURCE_COUNT];
+    float* pose;
+    int leg_count;
+} Blend_Layers;
+
+struct world;
+
+extern const float blend_ik_segment_weight[];
+
+size_t blend_memory_size(int leg_count);
+bool blend_init(Blend_Layers* b, Arena* level, int leg_count);
+void blend_poses(struct world* w, float dt);
+
+static inline void blend_set(Blend_Layers* b, Blend_Source source, int leg, float rotation, float weight)
+{
+    b->rotation[source][leg] = rotation;
+    b->weight[source][leg] = weight;
+}
+
+#endif
@@ -0,0 +1,147 @@
+#include "raylib.h"
+#include <stdlib.h>
+#include <math.h>
+#include "main.h"
+#include "bvh.h"
+#include "morton.h"
+
+size_t bvh_memory_size(int max_legs)
+{
+    int max_nodes = 2 * max_legs;
+    return (size_t)max_nodes * sizeof(Bvh_Node) + (size_t)max_legs * (sizeof(int) + sizeof(Bvh_Entry)) + 3 * 32;
+}
+
+bool bvh_init(Bvh_Tree* t, Arena* level, int max_legs)
+{
+    *t = (Bvh_Tree) {.root = -1, .max_legs = max_legs};
+    t->nodes = ARENA_PUSH_ARRAY(level, Bvh_Node, 2 * max_legs);
+    t->leaf = ARENA_PUSH_ARRAY(level, int, max_legs);
+    t->order = ARENA_PUSH_ARRAY(level, Bvh_Entry, max_legs);
+    return t->nodes != NULL && t->leaf != NULL && t->order != NULL;
+}
+
+static Bvh_Node tight_box(const Leg_Points* lp)
+{
+    return (Bvh_Node) {
+        .min_x = fminf(fminf(lp->top_right.x, lp->top_left.x), fminf(lp->bot_left.x, lp->bot_right.x)),
+        .min_y = fminf(fminf(lp->top_right.y, lp->top_left.y), fminf(lp->bot_left.y, lp->bot_right.y)),
+        .max_x = fmaxf(fmaxf(lp->top_right.x, lp->top_left.x), fmaxf(lp->bot_left.x, lp->bot_right.x)),
+        .max_y = fmaxf(fmaxf(lp->top_right.y, lp->top_left.y), fmaxf(lp->bot_left.y, lp->bot_right.y)),
+    };
+}
+
+static void fatten(Bvh_Node* n, const Bvh_Node* box)
+{
+    n->min_x = box->min_x - BVH_FAT_MARGIN;
+    n->min_y = box->min_y - BVH_FAT_MARGIN;
+    n->max_x = box->max_x + BVH_FAT_MARGIN;
+    n->max_y = box->max_y + BVH_FAT_MARGIN;
+}
+
+// Sets n's box to the union of its children's; false if it did not change.
+static bool refit_node(Bvh_Tree* t, Bvh_Node* n)
+{
+    const Bvh_Node* a = &t->nodes[n->left];
+    const Bvh_Node* b = &t->nodes[n->right];
+    float min_x = fminf(a->min_x, b->min_x), min_y = fminf(a->min_y, b->min_y);
+    float max_x = fmaxf(a->max_x, b->max_x), max_y = fmaxf(a->max_y, b->max_y);
+    if (min_x == n->min_x && min_y == n->min_y && max_x == n->max_x && max_y == n->max_y) return false;
+    n->min_x = min_x;
+    n->min_y = min_y;
+    n->max_x = max_x;
+    n->max_y = max_y;
+    return true;
+}
+
+static int compare_entry(const void* a, const void* b)
+{
+    uint32_t ca = ((const Bvh_Entry*)a)->code, cb = ((const Bvh_Entry*)b)->code;
+    if (ca != cb) return (ca > cb) - (ca < cb);
+    return ((const Bvh_Entry*)a)->leg - ((const Bvh_Entry*)b)->leg;
+}
+
+// Builds the subtree over order[lo, hi) and returns its node.
+static int build(Bvh_Tree* t, const World* w, int lo, int hi, int parent)
+{
+    int i = t->node_count++;
+    Bvh_Node* n = &t->nodes[i];
+    n->parent = parent;
+    if (hi - lo == 1) {
+        int leg = t->order[lo].leg;
+        Bvh_Node box = tight_box(&w->leg_points[leg]);
+        fatten(n, &box);
+        n->left = n->right = -1;
+        n->leg = leg;
+        t->leaf[leg] = i;
+        return i;
+    }
+    int mid = lo + (hi - lo) / 2;
+    n->leg = -1;
+    n->left = build(t, w, lo, mid, i);
+    n->right = build(t, w, mid, hi, i);
+    n = &t->nodes[i];
+    n->min_x = n->min_y = INFINITY;
+    n->max_x = n->max_y = -INFINITY;
+    refit_node(t, n);
+    return i;
+}
+
+void bvh_rebuild(Bvh_Tree* t, const World* w)
+{
+    int n = w->leg_count < t->max_legs ? w->leg_count : t->max_legs;
+    t->leg_count = n;
+    t->node_count = 0;
+    t->root = -1;
+    if (n == 0) return;
+
+    float min_x = INFINITY, min_y = INFINITY, max_x = -INFINITY, max_y = -INFINITY;
+    for (int l = 0; l < n; l++) {
+        Bvh_Node box = tight_box(&w->leg_points[l]);
+        min_x = fminf(min_x, box.min_x);
+        min_y = fminf(min_y, box.min_y);
+        max_x = fmaxf(max_x, box.max_x);
+        max_y = fmaxf(max_y, box.max_y);
+    }
+    float sx = 65535.0f / fmaxf(max_x - min_x, 1.0f), sy = 65535.0f / fmaxf(max_y - min_y, 1.0f);
+    for (int l = 0; l < n; l++) {
+        Bvh_Node box = tight_box(&w->leg_points[l]);
+        uint32_t x = (uint32_t)((0.5f * (box.min_x + box.max_x) - min_x) * sx);
+        uint32_t y = (uint32_t)((0.5f * (box.min_y + box.max_y) - min_y) * sy);
+        t->order[l] = (Bvh_Entry) {morton_code(x, y), l};
+    }
+    qsort(t->order, n, sizeof(Bvh_Entry), compare_entry);
+    t->root = build(t, w, 0, n, -1);
+}
+
+void bvh_move_leg(Bvh_Tree* t, int leg, const Leg_Points* lp)
+{
+    if (leg >= t->leg_count) return;
+    Bvh_Node* n = &t->nodes[t->leaf[leg]];
+    Bvh_Node box = tight_box(lp);
+    if (box.min_x >= n->min_x && box.min_y >= n->min_y && box.max_x <= n->max_x && box.max_y <= n->max_y) return;
+    fatten(n, &box);
+    t->refits++;
+    for (int p = n->parent; p != -1 && refit_node(t, &t->nodes[p]); p = t->nodes[p].parent) {}
+}
+
+// Writes up to max_legs legs whose fat box overlaps the query box, in tree
+// order, and returns how many there were.
+int bvh_query(const Bvh_Tree* t, float min_x, float min_y, float max_x, float max_y, int* legs, int max_legs)
+{
+    if (t->root == -1) return 0;
+    int stack[BVH_STACK_SIZE];
+    int top = 0, found = 0;
+    stack[top++] = t->root;
+    while (top > 0) {
+        const Bvh_Node* n = &t->nodes[stack[--top]];
+        if (n->min_x > max_x || n->max_x < min_x || n->min_y > max_y || n->max_y < min_y) continue;
+        if (n->leg != -1) {
+            if (found < max_legs) legs[found] = n->leg;
+            found++;
+        } else if (top + 2 <= BVH_STACK_SIZE) {
+            stack[top++] = n->right;
+            stack[top++] = n->left;
+        }
+    }
+    return found;
+}
@@ -0,0 +1,62 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "arena.h"
+
+// Bounding volume tree over the leg colliders, for ball/leg broadphase.
+// Every leaf holds one leg's box fattened by BVH_FAT_MARGIN. When
+// update_joint_positions moves a leg, bvh_move_leg checks the new tight box
+// against the fat one; only a box that escapes gets a new fat box, and its
+// ancestors are refit bottom-up until one comes out unchanged. Legs never
+// leave their hip's reach, so the tree keeps its shape and a still crowd
+// costs nothing; the refit work follows the legs that moved.
+//
+// bvh_rebuild builds the tree top-down over the legs sorted by the Morton
+// code of their centres, cut in half at every level, and runs whenever the
+// leg count changes. Queries walk it with an explicit stack of
+// BVH_STACK_SIZE nodes, which a balanced tree of any MAX_CHARACTERS crowd
+// stays well inside.
+
+#define BVH_FAT_MARGIN 8.0f
+#define BVH_STACK_SIZE 64
+
+typedef struct bvh_node {
+    float min_x;
+    float min_y;
+    float max_x;
+    float max_y;
+    int parent;
+    int left;
+    int right;
+    int leg;
+} Bvh_Node;
+
+// Sort entry for the build.
+typedef struct bvh_entry {
+    uint32_t code;
+    int32_t leg;
+} Bvh_Entry;
+
+typedef struct bvh_tree {
+    Bvh_Node* nodes;
+    int* leaf;
+    Bvh_Entry* order;
+    int root;
+    int node_count;
+    int leg_count;
+    int max_legs;
+    long long refits;
+} Bvh_Tree;
+
+struct world;
+struct leg_points;
+
+size_t bvh_memory_size(int max_legs);
+bool bvh_init(Bvh_Tree* t, Arena* level, int max_legs);
+void bvh_rebuild(Bvh_Tree* t, const struct world* w);
+void bvh_move_leg(Bvh_Tree* t, int leg, const struct leg_points* lp);
+int bvh_query(const Bvh_Tree* t, float min_x, float min_y, float max_x, float max_y, int* legs, int max_legs);
+
+#endif
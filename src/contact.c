@@ -0,0 +1,517 @@
+#include "raylib.h"
+#include "raymath.h"
+#include <stdlib.h>
+#include <math.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#include "main.h"
+#include "dispatch.h"
+#if defined(DISPATCH_AVX2)
+#include <immintrin.h>
+#endif
+
+#include "contact.h"
+
+_Static_assert(MAX_BALLS <= CONTACT_MAX_BALLS, "ball indices must fit the 16-bit halves of a contact key");
+
+typedef struct ball_contacts {
+    uint32_t* key;
+    int32_t* a;
+    int32_t* b;
+    float* nx;
+    float* ny;
+    float* bias;
+    float* push;
+    float* mass;
+    float* impulse;
+    float* split;
+    int32_t* source;
+    uint8_t* color;
+    int count;
+} Ball_Contacts;
+
+typedef struct key_entry {
+    uint32_t key;
+    int32_t index;
+} Key_Entry;
+
+typedef struct sweep_entry {
+    float min_x;
+    int ball;
+} Sweep_Entry;
+
+size_t contact_memory_size(int max_balls)
+{
+    return (size_t)max_balls * BALL_CONTACTS_PER_BALL * (sizeof(uint32_t) + sizeof(float)) + 2 * 16;
+}
+
+bool contact_init(Contact_Cache* c, Arena* level, int max_balls)
+{
+    if (max_balls > CONTACT_MAX_BALLS) return false;
+    int capacity = max_balls * BALL_CONTACTS_PER_BALL;
+    *c = (Contact_Cache) {.capacity = capacity};
+    c->key = ARENA_PUSH_ARRAY(level, uint32_t, capacity);
+    c->impulse = ARENA_PUSH_ARRAY(level, float, capacity);
+    return c->key != NULL && c->impulse != NULL;
+}
+
+static bool push_contacts(Arena* a, Ball_Contacts* c, int capacity)
+{
+    *c = (Ball_Contacts) {0};
+    c->key = ARENA_PUSH_ARRAY(a, uint32_t, capacity);
+    c->a = ARENA_PUSH_ARRAY(a, int32_t, capacity);
+    c->b = ARENA_PUSH_ARRAY(a, int32_t, capacity);
+    c->nx = ARENA_PUSH_ARRAY(a, float, capacity);
+    c->ny = ARENA_PUSH_ARRAY(a, float, capacity);
+    c->bias = ARENA_PUSH_ARRAY(a, float, capacity);
+    c->push = ARENA_PUSH_ARRAY(a, float, capacity);
+    c->mass = ARENA_PUSH_ARRAY(a, float, capacity);
+    c->impulse = ARENA_PUSH_ARRAY(a, float, capacity);
+    c->split = ARENA_PUSH_ARRAY(a, float, capacity);
+    c->source = ARENA_PUSH_ARRAY(a, int32_t, capacity);
+    c->color = ARENA_PUSH_ARRAY(a, uint8_t, capacity);
+    return c->key != NULL && c->a != NULL && c->b != NULL && c->nx != NULL && c->ny != NULL
+        && c->bias != NULL && c->push != NULL && c->mass != NULL && c->impulse != NULL && c->split != NULL && c->source != NULL && c->color != NULL;
+}
+
+static int compare_sweep(const void* a, const void* b)
+{
+    float xa = ((const Sweep_Entry*)a)->min_x;
+    float xb = ((const Sweep_Entry*)b)->min_x;
+    return (xa > xb) - (xa < xb);
+}
+
+static int compare_key(const void* a, const void* b)
+{
+    uint32_t ka = ((const Key_Entry*)a)->key;
+    uint32_t kb = ((const Key_Entry*)b)->key;
+    return (ka > kb) - (ka < kb);
+}
+
+// Adds a contact between ball a and either ball b or, when b is the static
+// slot, a bound. n points from a to b and gap is the distance still between
+// their surfaces (negative when overlapping).
+static void add_contact(Ball_Contacts* c, int capacity, uint32_t key, int a, int b, Vector2 n, float gap, float mass, float h)
+{
+    if (c->count >= capacity) return;
+    int i = c->count++;
+    c->key[i] = key;
+    c->a[i] = a;
+    c->b[i] = b;
+    c->nx[i] = n.x;
+    c->ny[i] = n.y;
+    // Apart, the pair may close the gap this step. Overlapping, a Baumgarte
+    // fraction of the overlap is pushed out through the pseudo-velocities.
+    c->bias[i] = gap > 0.0f ? gap / h : 0.0f;
+    c->push[i] = gap < 0.0f ? BALL_CONTACT_BAUMGARTE * gap / h : 0.0f;
+    c->mass[i] = mass;
+    c->impulse[i] = 0.0f;
+    c->split[i] = 0.0f;
+}
+
+static void find_contacts(World* w, Ball_Contacts* c, int capacity, Sweep_Entry* sweep, float h)
+{
+    int n = w->ball_count;
+    int fixed = n;
+    // Each ball's extent is grown by how far it can travel this step, so a
+    // pair is found if it can touch before the next step. Balls in event
+    // driven flight are left out.
+    int m = 0;
+    for (int i = 0; i < n; i++) {
+        const Ball* b = &w->balls[i];
+        if (w->events.airborne[i]) continue;
+        sweep[m++] = (Sweep_Entry) {b->centre_position.x - b->radius - fabsf(b->velocity.x) * h, i};
+    }
+    qsort(sweep, m, sizeof(Sweep_Entry), compare_sweep);
+
+    for (int s = 0; s < m; s++) {
+        int i = sweep[s].ball;
+        const Ball* bi = &w->balls[i];
+        float travel_i = Vector2Length(bi->velocity) * h;
+        float max_x = bi->centre_position.x + bi->radius + fabsf(bi->velocity.x) * h + BALL_CONTACT_MARGIN;
+        for (int t = s + 1; t < m && sweep[t].min_x <= max_x; t++) {
+            int j = sweep[t].ball;
+            const Ball* bj = &w->balls[j];
+            Vector2 d = Vector2Subtract(bj->centre_position, bi->centre_position);
+            float reach = bi->radius + bj->radius + BALL_CONTACT_MARGIN + travel_i + Vector2Length(bj->velocity) * h;
+            float dist2 = Vector2LengthSqr(d);
+            if (dist2 > reach * reach) continue;
+            float dist = sqrtf(dist2);
+            Vector2 normal = dist > 1e-6f ? Vector2Scale(d, 1.0f / dist) : (Vector2) {0.0f, -1.0f};
+            int a = i < j ? i : j, b = i < j ? j : i;
+            if (a != i) normal = Vector2Negate(normal);
+            add_contact(c, capacity, (uint32_t)a << 16 | (uint32_t)b, a, b, normal,
+                dist - bi->radius - bj->radius, 0.5f, h);
+        }
+
+        Vector2 p = bi->centre_position;
+        float r = bi->radius;
+        float margin = BALL_CONTACT_MARGIN + travel_i;
+        if (p.y + r + margin > BALL_FLOOR_Y) {
+            add_contact(c, capacity, (uint32_t)i << 16 | CONTACT_FLOOR, i, fixed, (Vector2) {0.0f, 1.0f},
+                BALL_FLOOR_Y - p.y - r, 1.0f, h);
+        }
+        if (p.x - r - margin < 0.0f) {
+            add_contact(c, capacity, (uint32_t)i << 16 | CONTACT_LEFT_WALL, i, fixed, (Vector2) {-1.0f, 0.0f},
+                p.x - r, 1.0f, h);
+        }
+        if (p.x + r + margin > WIDTH) {
+            add_contact(c, capacity, (uint32_t)i << 16 | CONTACT_RIGHT_WALL, i, fixed, (Vector2) {1.0f, 0.0f},
+                WIDTH - p.x - r, 1.0f, h);
+        }
+    }
+}
+
+// Velocities and split-impulse pseudo-velocities of the balls, plus one
+// static slot at index ball_count with zero inverse mass.
+typedef struct ball_state {
+    float* vx;
+    float* vy;
+    float* px;
+    float* py;
+    float* inv_mass;
+} Ball_State;
+
+static void solve_contact(Ball_State* v, Ball_Contacts* c, int i)
+{
+    int a = c->a[i], b = c->b[i];
+    float nx = c->nx[i], ny = c->ny[i];
+    float wa = v->inv_mass[a], wb = v->inv_mass[b];
+
+    float vn = (v->vx[b] - v->vx[a]) * nx + (v->vy[b] - v->vy[a]) * ny;
+    float p = fmaxf(c->impulse[i] - (vn + c->bias[i]) * c->mass[i], 0.0f);
+    float dp = p - c->impulse[i];
+    c->impulse[i] = p;
+    v->vx[a] -= wa * dp * nx;
+    v->vy[a] -= wa * dp * ny;
+    v->vx[b] += wb * dp * nx;
+    v->vy[b] += wb * dp * ny;
+
+    float pn = (v->px[b] - v->px[a]) * nx + (v->py[b] - v->py[a]) * ny;
+    float q = fmaxf(c->split[i] - (pn + c->push[i]) * c->mass[i], 0.0f);
+    float dq = q - c->split[i];
+    c->split[i] = q;
+    v->px[a] -= wa * dq * nx;
+    v->py[a] -= wa * dq * ny;
+    v->px[b] += wb * dq * nx;
+    v->py[b] += wb * dq * ny;
+}
+
+// One colour: no two contacts share a ball, so four or eight are gathered,
+// solved and scattered together. The static slot has zero inverse mass and
+// zero velocity, so writing it back from several lanes leaves it unchanged.
+static void solve_color_scalar(Ball_State* v, Ball_Contacts* c, int begin, int end)
+{
+    for (int i = begin; i < end; i++) solve_contact(v, c, i);
+}
+
+#if defined(__SSE2__)
+static void solve_color_sse2(Ball_State* v, Ball_Contacts* c, int begin, int end)
+{
+    int i = begin;
+    const __m128 zero = _mm_setzero_ps();
+    #define GATHER(arr, idx) _mm_setr_ps((arr)[(idx)[0]], (arr)[(idx)[1]], (arr)[(idx)[2]], (arr)[(idx)[3]])
+    for (; i + 4 <= end; i += 4) {
+        const int32_t* ia = &c->a[i];
+        const int32_t* ib = &c->b[i];
+        __m128 wa = GATHER(v->inv_mass, ia);
+        __m128 wb = GATHER(v->inv_mass, ib);
+        __m128 nx = _mm_loadu_ps(&c->nx[i]);
+        __m128 ny = _mm_loadu_ps(&c->ny[i]);
+        __m128 mass = _mm_loadu_ps(&c->mass[i]);
+        float out[8][4];
+
+        // Real velocities, against the speculative bias; this impulse is cached.
+        __m128 vxa = GATHER(v->vx, ia), vya = GATHER(v->vy, ia);
+        __m128 vxb = GATHER(v->vx, ib), vyb = GATHER(v->vy, ib);
+        __m128 old = _mm_loadu_ps(&c->impulse[i]);
+        __m128 vn = _mm_add_ps(_mm_mul_ps(_mm_sub_ps(vxb, vxa), nx), _mm_mul_ps(_mm_sub_ps(vyb, vya), ny));
+        __m128 p = _mm_max_ps(_mm_sub_ps(old, _mm_mul_ps(_mm_add_ps(vn, _mm_loadu_ps(&c->bias[i])), mass)), zero);
+        __m128 dp = _mm_sub_ps(p, old);
+        _mm_storeu_ps(&c->impulse[i], p);
+        __m128 jx = _mm_mul_ps(dp, nx), jy = _mm_mul_ps(dp, ny);
+        _mm_storeu_ps(out[0], _mm_sub_ps(vxa, _mm_mul_ps(wa, jx)));
+        _mm_storeu_ps(out[1], _mm_sub_ps(vya, _mm_mul_ps(wa, jy)));
+        _mm_storeu_ps(out[2], _mm_add_ps(vxb, _mm_mul_ps(wb, jx)));
+        _mm_storeu_ps(out[3], _mm_add_ps(vyb, _mm_mul_ps(wb, jy)));
+
+        // Pseudo-velocities, against the overlap push; thrown away after the step.
+        __m128 pxa = GATHER(v->px, ia), pya = GATHER(v->py, ia);
+        __m128 pxb = GATHER(v->px, ib), pyb = GATHER(v->py, ib);
+        __m128 old_q = _mm_loadu_ps(&c->split[i]);
+        __m128 pn = _mm_add_ps(_mm_mul_ps(_mm_sub_ps(pxb, pxa), nx), _mm_mul_ps(_mm_sub_ps(pyb, pya), ny));
+        __m128 q = _mm_max_ps(_mm_sub_ps(old_q, _mm_mul_ps(_mm_add_ps(pn, _mm_loadu_ps(&c->push[i])), mass)), zero);
+        __m128 dq = _mm_sub_ps(q, old_q);
+        _mm_storeu_ps(&c->split[i], q);
+        __m128 kx = _mm_mul_ps(dq, nx), ky = _mm_mul_ps(dq, ny);
+        _mm_storeu_ps(out[4], _mm_sub_ps(pxa, _mm_mul_ps(wa, kx)));
+        _mm_storeu_ps(out[5], _mm_sub_ps(pya, _mm_mul_ps(wa, ky)));
+        _mm_storeu_ps(out[6], _mm_add_ps(pxb, _mm_mul_ps(wb, kx)));
+        _mm_storeu_ps(out[7], _mm_add_ps(pyb, _mm_mul_ps(wb, ky)));
+
+        for (int k = 0; k < 4; k++) {
+            v->vx[ia[k]] = out[0][k];
+            v->vy[ia[k]] = out[1][k];
+            v->vx[ib[k]] = out[2][k];
+            v->vy[ib[k]] = out[3][k];
+            v->px[ia[k]] = out[4][k];
+            v->py[ia[k]] = out[5][k];
+            v->px[ib[k]] = out[6][k];
+            v->py[ib[k]] = out[7][k];
+        }
+    }
+    #undef GATHER
+    solve_color_scalar(v, c, i, end);
+}
+#else
+#define solve_color_sse2 NULL
+#endif
+
+#if defined(DISPATCH_AVX2)
+static TARGET_AVX2 void solve_color_avx2(Ball_State* v, Ball_Contacts* c, int begin, int end)
+{
+    int i = begin;
+    const __m256 zero = _mm256_setzero_ps();
+    for (; i + 8 <= end; i += 8) {
+        const int32_t* ia = &c->a[i];
+        const int32_t* ib = &c->b[i];
+        __m256i va = _mm256_loadu_si256((const __m256i*)ia);
+        __m256i vb = _mm256_loadu_si256((const __m256i*)ib);
+        __m256 wa = _mm256_i32gather_ps(v->inv_mass, va, 4);
+        __m256 wb = _mm256_i32gather_ps(v->inv_mass, vb, 4);
+        __m256 nx = _mm256_loadu_ps(&c->nx[i]);
+        __m256 ny = _mm256_loadu_ps(&c->ny[i]);
+        __m256 mass = _mm256_loadu_ps(&c->mass[i]);
+        float out[8][8];
+
+        // Real velocities, against the speculative bias; this impulse is cached.
+        __m256 vxa = _mm256_i32gather_ps(v->vx, va, 4), vya = _mm256_i32gather_ps(v->vy, va, 4);
+        __m256 vxb = _mm256_i32gather_ps(v->vx, vb, 4), vyb = _mm256_i32gather_ps(v->vy, vb, 4);
+        __m256 old = _mm256_loadu_ps(&c->impulse[i]);
+        __m256 vn = _mm256_add_ps(_mm256_mul_ps(_mm256_sub_ps(vxb, vxa), nx), _mm256_mul_ps(_mm256_sub_ps(vyb, vya), ny));
+        __m256 p = _mm256_max_ps(_mm256_sub_ps(old, _mm256_mul_ps(_mm256_add_ps(vn, _mm256_loadu_ps(&c->bias[i])), mass)), zero);
+        __m256 dp = _mm256_sub_ps(p, old);
+        _mm256_storeu_ps(&c->impulse[i], p);
+        __m256 jx = _mm256_mul_ps(dp, nx), jy = _mm256_mul_ps(dp, ny);
+        _mm256_storeu_ps(out[0], _mm256_sub_ps(vxa, _mm256_mul_ps(wa, jx)));
+        _mm256_storeu_ps(out[1], _mm256_sub_ps(vya, _mm256_mul_ps(wa, jy)));
+        _mm256_storeu_ps(out[2], _mm256_add_ps(vxb, _mm256_mul_ps(wb, jx)));
+        _mm256_storeu_ps(out[3], _mm256_add_ps(vyb, _mm256_mul_ps(wb, jy)));
+
+        // Pseudo-velocities, against the overlap push; thrown away after the step.
+        __m256 pxa = _mm256_i32gather_ps(v->px, va, 4), pya = _mm256_i32gather_ps(v->py, va, 4);
+        __m256 pxb = _mm256_i32gather_ps(v->px, vb, 4), pyb = _mm256_i32gather_ps(v->py, vb, 4);
+        __m256 old_q = _mm256_loadu_ps(&c->split[i]);
+        __m256 pn = _mm256_add_ps(_mm256_mul_ps(_mm256_sub_ps(pxb, pxa), nx), _mm256_mul_ps(_mm256_sub_ps(pyb, pya), ny));
+        __m256 q = _mm256_max_ps(_mm256_sub_ps(old_q, _mm256_mul_ps(_mm256_add_ps(pn, _mm256_loadu_ps(&c->push[i])), mass)), zero);
+        __m256 dq = _mm256_sub_ps(q, old_q);
+        _mm256_storeu_ps(&c->split[i], q);
+        __m256 kx = _mm256_mul_ps(dq, nx), ky = _mm256_mul_ps(dq, ny);
+        _mm256_storeu_ps(out[4], _mm256_sub_ps(pxa, _mm256_mul_ps(wa, kx)));
+        _mm256_storeu_ps(out[5], _mm256_sub_ps(pya, _mm256_mul_ps(wa, ky)));
+        _mm256_storeu_ps(out[6], _mm256_add_ps(pxb, _mm256_mul_ps(wb, kx)));
+        _mm256_storeu_ps(out[7], _mm256_add_ps(pyb, _mm256_mul_ps(wb, ky)));
+
+        for (int k = 0; k < 8; k++) {
+            v->vx[ia[k]] = out[0][k];
+            v->vy[ia[k]] = out[1][k];
+            v->vx[ib[k]] = out[2][k];
+            v->vy[ib[k]] = out[3][k];
+            v->px[ia[k]] = out[4][k];
+            v->py[ia[k]] = out[5][k];
+            v->px[ib[k]] = out[6][k];
+            v->py[ib[k]] = out[7][k];
+        }
+    }
+    solve_color_scalar(v, c, i, end);
+}
+#else
+#define solve_color_avx2 NULL
+#endif
+
+Solve_Kernel* const contact_solve_kernels[CPU_LEVEL_COUNT] = {
+    solve_color_scalar, solve_color_sse2, solve_color_avx2,
+};
+
+static float check_random(uint32_t* s)
+{
+    *s = *s * 1664525u + 1013904223u;
+    return (float)(*s >> 8) / 16777216.0f;
+}
+
+// Solves one randomized colour with k and with the scalar reference, and
+// returns the largest difference in velocities and impulses. Some contacts
+// are against the static slot, several lanes at once.
+float contact_check_kernel(Solve_Kernel* k, uint32_t seed)
+{
+    enum { CHECK_BALLS = 64, CHECK_CONTACTS = 27 };
+    float vel[2][4][CHECK_BALLS + 1], inv_mass[CHECK_BALLS + 1];
+    float nx[CHECK_CONTACTS], ny[CHECK_CONTACTS], bias[CHECK_CONTACTS], push[CHECK_CONTACTS], mass[CHECK_CONTACTS];
+    float impulse[2][CHECK_CONTACTS], split[2][CHECK_CONTACTS];
+    int32_t a[CHECK_CONTACTS], b[CHECK_CONTACTS], order[CHECK_BALLS];
+
+    uint32_t s = seed;
+    for (int i = 0; i <= CHECK_BALLS; i++) {
+        for (int f = 0; f < 4; f++) vel[0][f][i] = vel[1][f][i] = i < CHECK_BALLS ? check_random(&s) * 20.0f - 10.0f : 0.0f;
+        inv_mass[i] = i < CHECK_BALLS ? 1.0f : 0.0f;
+        if (i < CHECK_BALLS) order[i] = i;
+    }
+    // A shuffle, paired off, gives a colour with no shared ball.
+    for (int i = CHECK_BALLS - 1; i > 0; i--) {
+        int j = (int)(check_random(&s) * (float)(i + 1));
+        int32_t t = order[i];
+        order[i] = order[j];
+        order[j] = t;
+    }
+    for (int i = 0; i < CHECK_CONTACTS; i++) {
+        float angle = check_random(&s) * 2.0f * PI;
+        a[i] = order[2 * i];
+        b[i] = check_random(&s) < 0.3f ? CHECK_BALLS : order[2 * i + 1];
+        nx[i] = cosf(angle);
+        ny[i] = sinf(angle);
+        bias[i] = check_random(&s) * 4.0f - 2.0f;
+        push[i] = check_random(&s) * 2.0f - 1.0f;
+        mass[i] = b[i] == CHECK_BALLS ? 1.0f : 0.5f;
+        impulse[0][i] = impulse[1][i] = check_random(&s) * 3.0f;
+        split[0][i] = split[1][i] = 0.0f;
+    }
+
+    for (int r = 0; r < 2; r++) {
+        Ball_State v = {.vx = vel[r][0], .vy = vel[r][1], .px = vel[r][2], .py = vel[r][3], .inv_mass = inv_mass};
+        Ball_Contacts c = {.a = a, .b = b, .nx = nx, .ny = ny, .bias = bias, .push = push, .mass = mass,
+            .impulse = impulse[r], .split = split[r], .count = CHECK_CONTACTS};
+        (r == 0 ? solve_color_scalar : k)(&v, &c, 0, CHECK_CONTACTS);
+    }
+    float diff = 0.0f;
+    for (int f = 0; f < 4; f++) {
+        for (int i = 0; i <= CHECK_BALLS; i++) diff = fmaxf(diff, fabsf(vel[0][f][i] - vel[1][f][i]));
+    }
+    for (int i = 0; i < CHECK_CONTACTS; i++) {
+        diff = fmaxf(diff, fmaxf(fabsf(impulse[0][i] - impulse[1][i]), fabsf(split[0][i] - split[1][i])));
+    }
+    return diff;
+}
+
+// Applies contact impulses to the ball velocities for a step of h frames.
+// advance gets the velocity each ball should move with this step, which
+// includes the split-impulse overlap push the stored velocity does not. Returns the number
+// of contacts solved.
+int contact_solve_balls(World* w, float h, Vector2* advance)
+{
+    int n = w->ball_count;
+    for (int i = 0; i < n; i++) advance[i] = w->balls[i].velocity;
+    if (n == 0) return 0;
+    Contact_Cache* cache = &w->ball_contacts;
+    int capacity = cache->capacity;
+
+    size_t mark = arena_mark(w->scratch);
+    Ball_Contacts found, sorted;
+    Sweep_Entry* sweep = ARENA_PUSH_ARRAY(w->scratch, Sweep_Entry, n);
+    Key_Entry* order = ARENA_PUSH_ARRAY(w->scratch, Key_Entry, capacity);
+    uint32_t* used = ARENA_PUSH_ARRAY(w->scratch, uint32_t, n + 1);
+    Ball_State v = {
+        .vx = ARENA_PUSH_ARRAY(w->scratch, float, n + 1),
+        .vy = ARENA_PUSH_ARRAY(w->scratch, float, n + 1),
+        .px = ARENA_PUSH_ARRAY(w->scratch, float, n + 1),
+        .py = ARENA_PUSH_ARRAY(w->scratch, float, n + 1),
+        .inv_mass = ARENA_PUSH_ARRAY(w->scratch, float, n + 1),
+    };
+    if (sweep == NULL || order == NULL || used == NULL || v.vx == NULL || v.vy == NULL || v.px == NULL
+        || v.py == NULL || v.inv_mass == NULL
+        || !push_contacts(w->scratch, &found, capacity) || !push_contacts(w->scratch, &sorted, capacity)) {
+        arena_rewind(w->scratch, mark);
+        return 0;
+    }
+
+    find_contacts(w, &found, capacity, sweep, h);
+    for (int i = 0; i <= n; i++) {
+        v.vx[i] = i < n ? w->balls[i].velocity.x : 0.0f;
+        v.vy[i] = i < n ? w->balls[i].velocity.y : 0.0f;
+        v.px[i] = v.py[i] = 0.0f;
+        v.inv_mass[i] = i < n ? 1.0f : 0.0f;
+        used[i] = 0;
+    }
+
+    // Key order, then warm start by merging against last step's keys.
+    for (int i = 0; i < found.count; i++) order[i] = (Key_Entry) {found.key[i], i};
+    qsort(order, found.count, sizeof(Key_Entry), compare_key);
+    int cached = 0;
+    for (int k = 0; k < found.count; k++) {
+        int i = order[k].index;
+        while (cached < cache->count && cache->key[cached] < found.key[i]) cached++;
+        if (cached < cache->count && cache->key[cached] == found.key[i]) found.impulse[i] = cache->impulse[cached];
+    }
+
+    // Colour in key order so the colour buckets stay key-sorted too.
+    int color_count[BALL_CONTACT_COLORS] = {0};
+    int colors = 0;
+    for (int k = 0; k < found.count; k++) {
+        int i = order[k].index;
+        int a = found.a[i], b = found.b[i];
+        uint32_t busy = used[a] | (b == n ? 0 : used[b]);
+        int color = __builtin_ctz(~busy | (1u << (BALL_CONTACT_COLORS - 1)));
+        if (color < BALL_CONTACT_COLORS - 1) {
+            used[a] |= 1u << color;
+            if (b != n) used[b] |= 1u << color;
+        }
+        found.color[i] = (uint8_t)color;
+        color_count[color]++;
+        if (color + 1 > colors) colors = color + 1;
+    }
+    int start[BALL_CONTACT_COLORS + 1];
+    int next[BALL_CONTACT_COLORS];
+    start[0] = 0;
+    for (int k = 0; k < BALL_CONTACT_COLORS; k++) {
+        start[k + 1] = start[k] + color_count[k];
+        next[k] = start[k];
+    }
+    for (int k = 0; k < found.count; k++) {
+        int i = order[k].index;
+        int j = next[found.color[i]]++;
+        sorted.key[j] = found.key[i];
+        sorted.a[j] = found.a[i];
+        sorted.b[j] = found.b[i];
+        sorted.nx[j] = found.nx[i];
+        sorted.ny[j] = found.ny[i];
+        sorted.bias[j] = found.bias[i];
+        sorted.push[j] = found.push[i];
+        sorted.mass[j] = found.mass[i];
+        sorted.impulse[j] = found.impulse[i];
+        sorted.split[j] = 0.0f;
+        sorted.source[j] = k;
+    }
+    sorted.count = found.count;
+
+    for (int i = 0; i < sorted.count; i++) {
+        float p = sorted.impulse[i];
+        int a = sorted.a[i], b = sorted.b[i];
+        v.vx[a] -= v.inv_mass[a] * p * sorted.nx[i];
+        v.vy[a] -= v.inv_mass[a] * p * sorted.ny[i];
+        v.vx[b] += v.inv_mass[b] * p * sorted.nx[i];
+        v.vy[b] += v.inv_mass[b] * p * sorted.ny[i];
+    }
+    for (int it = 0; it < BALL_CONTACT_ITERATIONS; it++) {
+        for (int k = 0; k < colors; k++) {
+            if (k == BALL_CONTACT_COLORS - 1) {
+                for (int i = start[k]; i < start[k + 1]; i++) solve_contact(&v, &sorted, i);
+            } else {
+                kernels.solve_color(&v, &sorted, start[k], start[k + 1]);
+            }
+        }
+    }
+
+    // The push only moves the balls this step; it never becomes velocity.
+    for (int i = 0; i < n; i++) {
+        w->balls[i].velocity = (Vector2) {v.vx[i], v.vy[i]};
+        advance[i] = (Vector2) {v.vx[i] + v.px[i], v.vy[i] + v.py[i]};
+    }
+    for (int i = 0; i < sorted.count; i++) {
+        cache->key[sorted.source[i]] = sorted.key[i];
+        cache->impulse[sorted.source[i]] = sorted.impulse[i];
+    }
+    cache->count = sorted.count;
+
+    arena_rewind(w->scratch, mark);
+    return sorted.count;
+}
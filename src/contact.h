@@ -0,0 +1,59 @@
+#ifndef CONTACT_H
+#define CONTACT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "arena.h"
+#include "dispatch.h"
+
+// Ball-ball and ball-bounds contacts, solved at the velocity level with
+// sequential impulses. Pairs come from a sweep and prune over the balls'
+// x extents; the floor and side walls of the pitch are static contacts. Every
+// contact keeps an accumulated normal impulse, clamped to push only, and is
+// speculative: a pair still apart by s may close by s this step, so resting
+// balls meet without bouncing and fast ones cannot pass through.
+//
+// Accumulated impulses are cached between steps, sorted by a (ball, other)
+// key, and each new contact starts from its cached impulse. With the warm
+// start a resting pile only has to correct what changed since the last
+// step, so BALL_CONTACT_ITERATIONS stays small. Overlap is pushed out with
+// split impulses on separate pseudo-velocities that are neither cached nor
+// kept, so the Baumgarte push cannot build up in the warm start. Contacts are coloured so
+// that no two in a colour share a ball and are then solved four or eight at
+// a time in SIMD lanes.
+
+#define BALL_CONTACT_ITERATIONS 4
+#define BALL_CONTACT_MARGIN 2.0f
+#define BALL_CONTACT_BAUMGARTE 0.2f
+#define BALL_CONTACTS_PER_BALL 8
+#define BALL_CONTACT_COLORS 16
+#define BALL_FLOOR_Y HEIGHT
+
+// Keys of the static contacts: the ball index in the high half, the bound
+// in the low half. Ball indices share the low half with the bounds, so a
+// world holds at most CONTACT_MAX_BALLS balls.
+#define CONTACT_MAX_BALLS 0xfff0
+
+enum contact_bound {
+    CONTACT_FLOOR = CONTACT_MAX_BALLS,
+    CONTACT_LEFT_WALL,
+    CONTACT_RIGHT_WALL,
+};
+
+typedef struct contact_cache {
+    uint32_t* key;
+    float* impulse;
+    int count;
+    int capacity;
+} Contact_Cache;
+
+struct world;
+
+extern Solve_Kernel* const contact_solve_kernels[CPU_LEVEL_COUNT];
+
+size_t contact_memory_size(int max_balls);
+bool contact_init(Contact_Cache* c, Arena* level, int max_balls);
+int contact_solve_balls(struct world* w, float h, Vector2* advance);
+float contact_check_kernel(Solve_Kernel* k, uint32_t seed);
+
+#endif
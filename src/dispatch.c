@@ -0,0 +1,135 @@
+#include "raylib.h"
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "main.h"
+#include "dispatch.h"
+
+const char* cpu_level_names[CPU_LEVEL_COUNT] = {
+    [CPU_SCALAR] = "scalar",
+    [CPU_SSE2] = "sse2",
+    [CPU_AVX2] = "avx2",
+};
+
+// Empty until dispatch_init, which main runs before anything else.
+Kernels kernels;
+
+Cpu_Level cpu_detect(void)
+{
+#if defined(DISPATCH_AVX2)
+    // Checks the OS saves the YMM registers as well as the CPUID bit.
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return CPU_AVX2;
+#endif
+#if defined(__SSE2__)
+    return CPU_SSE2;
+#else
+    return CPU_SCALAR;
+#endif
+}
+
+bool cpu_level_parse(const char* name, Cpu_Level* level)
+{
+    for (int l = 0; l < CPU_LEVEL_COUNT; l++) {
+        if (strcmp(name, cpu_level_names[l]) == 0) {
+            *level = (Cpu_Level)l;
+            return true;
+        }
+    }
+    return false;
+}
+
+// The widest variant at or below level; every table has a scalar entry.
+#define PICK(table, level, out) do { \
+        int l_ = (level); \
+        while (l_ > CPU_SCALAR && (table)[l_] == NULL) l_--; \
+        (out) = (table)[l_]; \
+    } while (0)
+
+void dispatch_init(Cpu_Level max_level)
+{
+    Cpu_Level level = cpu_detect();
+    if (level > max_level) level = max_level;
+    kernels.level = level;
+    PICK(fast_sincos_kernels, level, kernels.sincos);
+    PICK(fast_atan2_kernels, level, kernels.atan2);
+    PICK(xpbd_project_kernels, level, kernels.project_color);
+    PICK(contact_solve_kernels, level, kernels.solve_color);
+}
+
+#undef PICK
+
+static float check_random(uint32_t* s)
+{
+    *s = *s * 1664525u + 1013904223u;
+    return (float)(*s >> 8) / 16777216.0f;
+}
+
+// Largest difference between an array kernel and the scalar one over
+// randomized inputs; n is odd so every variant runs its tail too.
+static float check_sincos(Sincos_Kernel* k, uint32_t seed)
+{
+    enum { CHECK_ANGLES = 1027 };
+    float x[CHECK_ANGLES], s[2][CHECK_ANGLES], c[2][CHECK_ANGLES];
+    for (int i = 0; i < CHECK_ANGLES; i++) x[i] = (check_random(&seed) * 2.0f - 1.0f) * FASTMATH_SINCOS_RANGE;
+    fast_sincos_kernels[CPU_SCALAR](x, s[0], c[0], CHECK_ANGLES);
+    k(x, s[1], c[1], CHECK_ANGLES);
+    float diff = 0.0f;
+    for (int i = 0; i < CHECK_ANGLES; i++) diff = fmaxf(diff, fmaxf(fabsf(s[0][i] - s[1][i]), fabsf(c[0][i] - c[1][i])));
+    return diff;
+}
+
+static float check_atan2(Atan2_Kernel* k, uint32_t seed)
+{
+    enum { CHECK_ANGLES = 1027 };
+    float y[CHECK_ANGLES], x[CHECK_ANGLES], out[2][CHECK_ANGLES];
+    for (int i = 0; i < CHECK_ANGLES; i++) {
+        // Every eighth point on an axis or at the origin.
+        y[i] = i % 8 == 0 ? 0.0f : check_random(&seed) * 400.0f - 200.0f;
+        x[i] = i % 16 == 0 ? 0.0f : check_random(&seed) * 400.0f - 200.0f;
+    }
+    fast_atan2_kernels[CPU_SCALAR](y, x, out[0], CHECK_ANGLES);
+    k(y, x, out[1], CHECK_ANGLES);
+    float diff = 0.0f;
+    for (int i = 0; i < CHECK_ANGLES; i++) diff = fmaxf(diff, fabsf(out[0][i] - out[1][i]));
+    return diff;
+}
+
+static bool report(const char* name, int level, float worst, float tolerance)
+{
+    if (worst < 0.0f) {
+        printf("dispatch: %-13s %-6s skipped, not supported here\n", name, cpu_level_names[level]);
+        return true;
+    }
+    bool pass = worst <= tolerance;
+    printf("dispatch: %-13s %-6s max diff %.3g vs scalar (tolerance %.3g) %s\n",
+        name, cpu_level_names[level], worst, tolerance, pass ? "ok" : "FAILED");
+    return pass;
+}
+
+// Cross-checks every variant this CPU can run against the scalar reference
+// over DISPATCH_CHECK_ROUNDS randomized inputs. The variants do the same
+// arithmetic as the reference, so they may only differ where a lane rounds
+// differently, such as an angle exactly between two quadrants.
+bool dispatch_self_test(void)
+{
+    Cpu_Level detected = cpu_detect();
+    printf("dispatch: cpu supports %s, running %s kernels\n", cpu_level_names[detected], cpu_level_names[kernels.level]);
+    bool ok = true;
+    #define CROSS_CHECK(name, table, check, tolerance) \
+        for (int l = CPU_SCALAR + 1; l < CPU_LEVEL_COUNT; l++) { \
+            if ((table)[l] == NULL) continue; \
+            float worst = -1.0f; \
+            if (l <= (int)detected) { \
+                worst = 0.0f; \
+                for (uint32_t r = 1; r <= DISPATCH_CHECK_ROUNDS; r++) worst = fmaxf(worst, check((table)[l], r * 2654435761u)); \
+            } \
+            ok = report(name, l, worst, tolerance) && ok; \
+        }
+    CROSS_CHECK("sincos", fast_sincos_kernels, check_sincos, 2.0f * FASTMATH_SINCOS_MAX_ERROR);
+    CROSS_CHECK("atan2", fast_atan2_kernels, check_atan2, 2.0f * FASTMATH_ATAN2_MAX_ERROR);
+    CROSS_CHECK("xpbd project", xpbd_project_kernels, xpbd_check_kernel, 1e-3f);
+    CROSS_CHECK("contact solve", contact_solve_kernels, contact_check_kernel, 1e-4f);
+    #undef CROSS_CHECK
+    return ok;
+}
@@ -0,0 +1,65 @@
+#ifndef DISPATCH_H
+#define DISPATCH_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Runtime selection of the SIMD kernels. Every hot kernel has a scalar
+// reference and, on x86, SSE2 and AVX2 variants. The module that owns a
+// kernel exports its variants as a table indexed by Cpu_Level, with NULL
+// where a level has no variant of its own. dispatch_init asks the CPU once
+// at startup what it runs, takes for each kernel the widest variant at or
+// below that level, and writes it into kernels. Callers go through kernels
+// and never look at the level.
+//
+// SSE2 is part of x86-64, so SSE2 variants are compiled whenever the
+// compiler targets it. AVX2 variants are compiled on any x86 GCC or Clang
+// through a per-function target attribute, so one binary carries both and
+// only calls AVX2 code on a CPU that reports it. Other architectures get
+// the scalar kernels.
+//
+// dispatch_self_test runs every variant the CPU can execute against the
+// scalar reference on randomized inputs and reports the largest
+// difference; --cpu caps the level, for comparing variants on one host.
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define DISPATCH_AVX2 1
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+#define DISPATCH_CHECK_ROUNDS 64
+
+typedef enum cpu_level {
+    CPU_SCALAR,
+    CPU_SSE2,
+    CPU_AVX2,
+    CPU_LEVEL_COUNT
+} Cpu_Level;
+
+struct particles;
+struct constraints;
+struct ball_state;
+struct ball_contacts;
+
+typedef void Sincos_Kernel(const float* x, float* s, float* c, int n);
+typedef void Atan2_Kernel(const float* y, const float* x, float* out, int n);
+typedef void Project_Kernel(struct particles* p, struct constraints* c, int begin, int end, int iteration, float inv_h2);
+typedef void Solve_Kernel(struct ball_state* v, struct ball_contacts* c, int begin, int end);
+
+typedef struct kernels {
+    Cpu_Level level;
+    Sincos_Kernel* sincos;
+    Atan2_Kernel* atan2;
+    Project_Kernel* project_color;
+    Solve_Kernel* solve_color;
+} Kernels;
+
+extern const char* cpu_level_names[CPU_LEVEL_COUNT];
+extern Kernels kernels;
+
+Cpu_Level cpu_detect(void);
+bool cpu_level_parse(const char* name, Cpu_Level* level);
+void dispatch_init(Cpu_Level max_level);
+bool dispatch_self_test(void);
+
+#endif
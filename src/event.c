@@ -0,0 +1,412 @@
+#include "raylib.h"
+#include "raymath.h"
+#include <stdlib.h>
+#include <math.h>
+#include "main.h"
+#include "event.h"
+
+// A ball's reach over one frame, for the ball-ball sweep.
+typedef struct frame_extent {
+    float min_x;
+    float max_x;
+    float min_y;
+    float max_y;
+    int32_t ball;
+} Frame_Extent;
+
+size_t event_memory_size(int max_balls, int max_characters)
+{
+    return (size_t)max_balls * EVENT_QUEUE_SLACK * sizeof(Flight_Event)
+        + (size_t)max_balls * (sizeof(bool) + sizeof(uint32_t) + 2 * sizeof(Vector2) + sizeof(double))
+        + (size_t)max_characters * (LEG_COUNT * (sizeof(Rectangle) + sizeof(float)) + sizeof(Rectangle)) + 9 * 16;
+}
+
+bool event_init(Event_Queue* q, Arena* level, int max_balls, int max_characters)
+{
+    *q = (Event_Queue) {
+        .capacity = max_balls * EVENT_QUEUE_SLACK,
+        .max_balls = max_balls,
+        .max_characters = max_characters,
+    };
+    q->heap = ARENA_PUSH_ARRAY(level, Flight_Event, q->capacity);
+    q->airborne = ARENA_PUSH_ARRAY(level, bool, max_balls);
+    q->stamp = ARENA_PUSH_ARRAY(level, uint32_t, max_balls);
+    q->launch_position = ARENA_PUSH_ARRAY(level, Vector2, max_balls);
+    q->launch_velocity = ARENA_PUSH_ARRAY(level, Vector2, max_balls);
+    q->launch_time = ARENA_PUSH_ARRAY(level, double, max_balls);
+    q->leg_bounds = ARENA_PUSH_ARRAY(level, Rectangle, max_characters * LEG_COUNT);
+    q->leg_speed = ARENA_PUSH_ARRAY(level, float, max_characters * LEG_COUNT);
+    q->reach_bounds = ARENA_PUSH_ARRAY(level, Rectangle, max_characters);
+    if (q->heap == NULL || q->airborne == NULL || q->stamp == NULL || q->launch_position == NULL
+        || q->launch_velocity == NULL || q->launch_time == NULL || q->leg_bounds == NULL
+        || q->leg_speed == NULL || q->reach_bounds == NULL) return false;
+    for (int i = 0; i < max_balls; i++) {
+        q->airborne[i] = false;
+        q->stamp[i] = 0;
+    }
+    return true;
+}
+
+// Hands every ball back to the stepped solver and empties the queue.
+void event_reset(World* w)
+{
+    Event_Queue* q = &w->events;
+    for (int i = 0; i < q->max_balls; i++) {
+        q->airborne[i] = false;
+        q->stamp[i]++;
+    }
+    q->count = 0;
+    q->airborne_count = 0;
+    q->leg_count = 0;
+}
+
+static bool event_before(const Flight_Event* a, const Flight_Event* b)
+{
+    return a->time < b->time;
+}
+
+static void sift_down(Event_Queue* q, int i)
+{
+    for (;;) {
+        int least = i, l = 2 * i + 1, r = 2 * i + 2;
+        if (l < q->count && event_before(&q->heap[l], &q->heap[least])) least = l;
+        if (r < q->count && event_before(&q->heap[r], &q->heap[least])) least = r;
+        if (least == i) return;
+        Flight_Event t = q->heap[i];
+        q->heap[i] = q->heap[least];
+        q->heap[least] = t;
+        i = least;
+    }
+}
+
+static bool event_stale(const Event_Queue* q, const Flight_Event* e)
+{
+    return !q->airborne[e->ball] || q->stamp[e->ball] != e->stamp;
+}
+
+// Every prediction leaves the ball's previous event behind in the heap. When
+// the heap fills up the stale ones are dropped and the rest re-heapified.
+static void push_event(Event_Queue* q, Flight_Event e)
+{
+    if (q->count == q->capacity) {
+        int kept = 0;
+        for (int i = 0; i < q->count; i++) {
+            if (!event_stale(q, &q->heap[i])) q->heap[kept++] = q->heap[i];
+        }
+        q->count = kept;
+        for (int i = kept / 2 - 1; i >= 0; i--) sift_down(q, i);
+        if (q->count == q->capacity) return;
+    }
+    int i = q->count++;
+    q->heap[i] = e;
+    while (i > 0 && event_before(&q->heap[i], &q->heap[(i - 1) / 2])) {
+        int parent = (i - 1) / 2;
+        Flight_Event t = q->heap[i];
+        q->heap[i] = q->heap[parent];
+        q->heap[parent] = t;
+        i = parent;
+    }
+}
+
+static Flight_Event pop_event(Event_Queue* q)
+{
+    Flight_Event top = q->heap[0];
+    q->heap[0] = q->heap[--q->count];
+    sift_down(q, 0);
+    return top;
+}
+
+// Roots of a t^2 + b t + c = 0 for a > 0, smaller first.
+static bool solve_quadratic(float a, float b, float c, float* t0, float* t1)
+{
+    float disc = b * b - 4.0f * a * c;
+    if (disc < 0.0f) return false;
+    float s = sqrtf(disc);
+    *t0 = (-b - s) / (2.0f * a);
+    *t1 = (-b + s) / (2.0f * a);
+    return true;
+}
+
+// First t in [0, t_max] at which p + v t + (0, g t^2 / 2) lies inside box,
+// or INFINITY. x is linear in t; y is a parabola opening downwards on
+// screen, so it is above the box's bottom edge between two roots and below
+// its top edge outside two others.
+static float box_entry(Vector2 p, Vector2 v, float g, Rectangle box, float t_max)
+{
+    float lo = 0.0f, hi = t_max;
+    if (v.x == 0.0f) {
+        if (p.x < box.x || p.x > box.x + box.width) return INFINITY;
+    } else {
+        float ta = (box.x - p.x) / v.x, tb = (box.x + box.width - p.x) / v.x;
+        lo = fmaxf(lo, fminf(ta, tb));
+        hi = fminf(hi, fmaxf(ta, tb));
+    }
+    if (lo > hi) return INFINITY;
+
+    float r0, r1;
+    if (!solve_quadratic(0.5f * g, v.y, p.y - (box.y + box.height), &r0, &r1)) return INFINITY;
+    lo = fmaxf(lo, r0);
+    hi = fminf(hi, r1);
+    if (lo > hi) return INFINITY;
+
+    float s0, s1;
+    if (!solve_quadratic(0.5f * g, v.y, p.y - box.y, &s0, &s1) || lo <= s0) return lo;
+    return fmaxf(lo, s1) <= hi ? fmaxf(lo, s1) : INFINITY;
+}
+
+// Frames until ball i, flying from its current state, can first touch the
+// floor, a wall or a leg; EVENT_HORIZON kind if nothing within the horizon.
+static float predict(World* w, int i, float g, int32_t* kind)
+{
+    Event_Queue* q = &w->events;
+    const Ball* b = &w->balls[i];
+    Vector2 p = b->centre_position, v = b->velocity;
+    float r = b->radius + EVENT_MARGIN;
+    float horizon = EVENT_HORIZON_FRAMES;
+    float t = horizon;
+    q->predictions++;
+
+    // Floor: the later root of p.y + v.y t + g t^2 / 2 = BALL_FLOOR_Y - r.
+    float floor_y = BALL_FLOOR_Y - r;
+    if (p.y >= floor_y) t = 0.0f;
+    else t = fminf(t, (-v.y + sqrtf(v.y * v.y + 2.0f * g * (floor_y - p.y))) / g);
+    if (p.x - r <= 0.0f || p.x + r >= WIDTH) t = 0.0f;
+    else if (v.x < 0.0f) t = fminf(t, (p.x - r) / -v.x);
+    else if (v.x > 0.0f) t = fminf(t, (WIDTH - r - p.x) / v.x);
+
+    // A character's legs never leave its reach box, so most characters are
+    // ruled out with one test. Legs may have moved for a frame since their
+    // boxes were taken.
+    int characters = q->leg_count / LEG_COUNT;
+    for (int c = 0; c < characters && t > 0.0f; c++) {
+        const Rectangle* reach = &q->reach_bounds[c];
+        Rectangle outer = {reach->x - r, reach->y - r, reach->width + 2.0f * r, reach->height + 2.0f * r};
+        if (box_entry(p, v, g, outer, t) >= t) continue;
+        for (int l = c * LEG_COUNT; l < (c + 1) * LEG_COUNT; l++) {
+            const Rectangle* leg = &q->leg_bounds[l];
+            float grow = q->leg_speed[l] * (horizon + 1.0f);
+            float min_x = fmaxf(leg->x - grow, reach->x) - r;
+            float min_y = fmaxf(leg->y - grow, reach->y) - r;
+            float max_x = fminf(leg->x + leg->width + grow, reach->x + reach->width) + r;
+            float max_y = fminf(leg->y + leg->height + grow, reach->y + reach->height) + r;
+            t = fminf(t, box_entry(p, v, g, (Rectangle) {min_x, min_y, max_x - min_x, max_y - min_y}, t));
+        }
+    }
+    *kind = t < horizon ? EVENT_IMPACT : EVENT_HORIZON;
+    return t;
+}
+
+static void wake(Event_Queue* q, int i)
+{
+    if (!q->airborne[i]) return;
+    q->airborne[i] = false;
+    q->stamp[i]++;
+    q->airborne_count--;
+    q->wakes++;
+}
+
+// Starts ball i's flight from its current state, unless something is due
+// within min_frames; then it stays with, or goes back to, the stepped solver.
+static void launch(World* w, int i, float g, float min_frames)
+{
+    Event_Queue* q = &w->events;
+    int32_t kind;
+    float t = predict(w, i, g, &kind);
+    q->stamp[i]++;
+    if (t < min_frames) {
+        wake(q, i);
+        return;
+    }
+    if (!q->airborne[i]) {
+        q->airborne[i] = true;
+        q->airborne_count++;
+    }
+    q->launch_position[i] = w->balls[i].centre_position;
+    q->launch_velocity[i] = w->balls[i].velocity;
+    q->launch_time[i] = q->clock;
+    push_event(q, (Flight_Event) {q->clock + t, i, q->stamp[i], kind});
+}
+
+static Rectangle points_bounds(const Leg_Points* lp)
+{
+    float min_x = fminf(fminf(lp->top_right.x, lp->top_left.x), fminf(lp->bot_left.x, lp->bot_right.x));
+    float max_x = fmaxf(fmaxf(lp->top_right.x, lp->top_left.x), fmaxf(lp->bot_left.x, lp->bot_right.x));
+    float min_y = fminf(fminf(lp->top_right.y, lp->top_left.y), fminf(lp->bot_left.y, lp->bot_right.y));
+    float max_y = fmaxf(fmaxf(lp->top_right.y, lp->top_left.y), fmaxf(lp->bot_left.y, lp->bot_right.y));
+    return (Rectangle) {min_x, min_y, max_x - min_x, max_y - min_y};
+}
+
+// Takes this frame's leg and reach boxes. Returns true when a prediction
+// made against the old ones may be too late: a leg moved faster than its
+// bound, legs were added, or a hip moved and the reach boxes changed.
+static bool measure_legs(World* w)
+{
+    Event_Queue* q = &w->events;
+    int characters = w->character_count < q->max_characters ? w->character_count : q->max_characters;
+    bool fresh = q->leg_count != characters * LEG_COUNT;
+    bool faster = fresh;
+    for (int c = 0; c < characters; c++) {
+        const Character* ch = &w->characters[c];
+        Vector2 hip = w->joints[ch->first_joint].centre_position;
+        float reach = 0.0f;
+        for (int k = 0; k < LEG_COUNT; k++) {
+            int l = ch->first_leg + k;
+            reach += Vector2Length((Vector2) {w->legs[l].shape.width, w->legs[l].shape.height});
+            Rectangle box = points_bounds(&w->leg_points[l]);
+            if (fresh) {
+                q->leg_speed[l] = EVENT_MIN_LEG_SPEED;
+            } else {
+                const Rectangle* old = &q->leg_bounds[l];
+                float speed = fmaxf(fabsf(box.x - old->x), fabsf(box.y - old->y));
+                speed = fmaxf(speed, fabsf(box.x + box.width - old->x - old->width));
+                speed = fmaxf(speed, fabsf(box.y + box.height - old->y - old->height));
+                if (speed > q->leg_speed[l]) {
+                    q->leg_speed[l] = speed * EVENT_LEG_SPEED_SLACK;
+                    faster = true;
+                }
+            }
+            q->leg_bounds[l] = box;
+        }
+        Rectangle box = {hip.x - reach, hip.y - reach, 2.0f * reach, 2.0f * reach};
+        const Rectangle* old = &q->reach_bounds[c];
+        if (old->x != box.x || old->y != box.y || old->width != box.width) faster = true;
+        q->reach_bounds[c] = box;
+    }
+    q->leg_count = characters * LEG_COUNT;
+    return faster;
+}
+
+static int compare_extent(const void* a, const void* b)
+{
+    float xa = ((const Frame_Extent*)a)->min_x;
+    float xb = ((const Frame_Extent*)b)->min_x;
+    return (xa > xb) - (xa < xb);
+}
+
+static bool balls_meet(const Ball* a, const Ball* b)
+{
+    // Gravity is shared, so the pair's relative motion is linear.
+    Vector2 d = Vector2Subtract(b->centre_position, a->centre_position);
+    Vector2 dv = Vector2Subtract(b->velocity, a->velocity);
+    float dv2 = Vector2LengthSqr(dv);
+    float closest = dv2 > 0.0f ? Clamp(-Vector2DotProduct(d, dv) / dv2, 0.0f, 1.0f) : 0.0f;
+    float reach = a->radius + b->radius + BALL_CONTACT_MARGIN;
+    return Vector2LengthSqr(Vector2Add(d, Vector2Scale(dv, closest))) <= reach * reach;
+}
+
+// Flags each ball in query that can come within contact reach of another
+// ball over the coming frame. Every ball's extent for the frame is sorted by
+// x, and only the query balls scan their neighbours, both ways, so a settled
+// pile around them costs nothing. Returns NULL when scratch is out.
+static bool* find_near_balls(World* w, float g, const bool* query)
+{
+    int n = w->ball_count;
+    bool* near = ARENA_PUSH_ARRAY(w->scratch, bool, n);
+    Frame_Extent* e = ARENA_PUSH_ARRAY(w->scratch, Frame_Extent, n);
+    if (near == NULL || e == NULL) return NULL;
+    float widest = 0.0f;
+    for (int i = 0; i < n; i++) {
+        const Ball* b = &w->balls[i];
+        Vector2 p = b->centre_position, v = b->velocity;
+        float r = b->radius + 0.5f * BALL_CONTACT_MARGIN;
+        float x1 = p.x + v.x, y1 = p.y + v.y + 0.5f * g;
+        float top = fminf(p.y, y1);
+        // The peak, when the ball turns over during the frame.
+        if (v.y < 0.0f && -v.y < g) top = fminf(top, p.y - 0.5f * v.y * v.y / g);
+        e[i] = (Frame_Extent) {fminf(p.x, x1) - r, fmaxf(p.x, x1) + r, top - r, fmaxf(p.y, y1) + r, i};
+        widest = fmaxf(widest, e[i].max_x - e[i].min_x);
+        near[i] = false;
+    }
+    qsort(e, n, sizeof(Frame_Extent), compare_extent);
+    for (int s = 0; s < n; s++) {
+        int i = e[s].ball;
+        if (!query[i]) continue;
+        for (int t = s + 1; t < n && e[t].min_x <= e[s].max_x && !near[i]; t++) {
+            if (e[t].min_y > e[s].max_y || e[s].min_y > e[t].max_y) continue;
+            near[i] = balls_meet(&w->balls[i], &w->balls[e[t].ball]);
+        }
+        for (int t = s - 1; t >= 0 && e[t].min_x >= e[s].min_x - widest && !near[i]; t--) {
+            if (e[t].max_x < e[s].min_x || e[t].min_y > e[s].max_y || e[s].min_y > e[t].max_y) continue;
+            near[i] = balls_meet(&w->balls[i], &w->balls[e[t].ball]);
+        }
+    }
+    return near;
+}
+
+// Before the stepped solver: hands back every airborne ball that can touch
+// something during the coming frame.
+void event_begin_frame(World* w, float dt)
+{
+    Event_Queue* q = &w->events;
+    if (!q->enabled) return;
+    const float g = GRAVITY * dt;
+
+    if (measure_legs(w)) {
+        for (int i = 0; i < w->ball_count; i++) {
+            if (q->airborne[i]) launch(w, i, g, 1.0f);
+        }
+    }
+
+    while (q->count > 0 && q->heap[0].time < q->clock + 1.0) {
+        Flight_Event e = pop_event(q);
+        if (event_stale(q, &e)) continue;
+        if (e.kind == EVENT_IMPACT) wake(q, e.ball);
+        else launch(w, e.ball, g, 1.0f);
+    }
+    if (q->airborne_count == 0) return;
+
+    size_t mark = arena_mark(w->scratch);
+    bool* near = find_near_balls(w, g, q->airborne);
+    for (int i = 0; i < w->ball_count; i++) {
+        if (near == NULL || near[i]) wake(q, i);
+    }
+    arena_rewind(w->scratch, mark);
+}
+
+// After the stepped solver: moves airborne balls to the frame boundary in
+// closed form and launches stepped balls that are touching nothing and have
+// no other ball within reach.
+void event_end_frame(World* w, float dt)
+{
+    Event_Queue* q = &w->events;
+    if (!q->enabled) return;
+    const float g = GRAVITY * dt;
+    int n = w->ball_count;
+    q->clock += 1.0;
+
+    for (int i = 0; i < n; i++) {
+        if (!q->airborne[i]) continue;
+        Ball* b = &w->balls[i];
+        float t = (float)(q->clock - q->launch_time[i]);
+        Vector2 p0 = q->launch_position[i], v0 = q->launch_velocity[i];
+        b->centre_position = (Vector2) {p0.x + v0.x * t, p0.y + v0.y * t + 0.5f * g * t * t};
+        b->velocity = (Vector2) {v0.x, v0.y + g * t};
+        b->hit = false;
+    }
+
+    // Launch candidates: stepped balls touching no leg and held by no
+    // contact. Speculative contacts that never pushed do not hold a ball.
+    size_t mark = arena_mark(w->scratch);
+    bool* candidate = ARENA_PUSH_ARRAY(w->scratch, bool, n);
+    if (candidate == NULL) {
+        arena_rewind(w->scratch, mark);
+        return;
+    }
+    for (int i = 0; i < n; i++) candidate[i] = !q->airborne[i] && !w->balls[i].hit;
+    const Contact_Cache* cache = &w->ball_contacts;
+    for (int k = 0; k < cache->count; k++) {
+        if (cache->impulse[k] <= 0.0f) continue;
+        uint32_t a = cache->key[k] >> 16, b = cache->key[k] & 0xffff;
+        if ((int)a < n) candidate[a] = false;
+        if ((int)b < n) candidate[b] = false;
+    }
+    bool any = false;
+    for (int i = 0; i < n; i++) any |= candidate[i];
+
+    // A settled pile has no candidates and skips the sweep.
+    bool* near = any ? find_near_balls(w, g, candidate) : NULL;
+    for (int i = 0; i < n && near != NULL; i++) {
+        if (candidate[i] && !near[i]) launch(w, i, g, EVENT_MIN_FLIGHT_FRAMES);
+    }
+    arena_rewind(w->scratch, mark);
+}
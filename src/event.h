@@ -0,0 +1,80 @@
+#ifndef EVENT_H
+#define EVENT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "arena.h"
+
+// Event-driven ball flight. A ball with nothing within reach is taken out
+// of the stepped solver and follows its gravity parabola in closed form:
+//
+//     p(t) = p0 + v0 t + 1/2 g t^2,   t in frames since launch
+//
+// On launch the first time the parabola can touch something is predicted:
+// the floor and side walls exactly, and every leg through its bounding box,
+// grown by the ball radius and by how far legs may move before then. The
+// prediction goes into a min-heap of events. Each frame only events due
+// before the frame boundary are popped, and each of those balls goes back to
+// the stepped solver for the frame. Other balls are handled by a sweep over
+// every ball's extent for the frame, so two balls in flight, or one in
+// flight and one in play, still meet in the stepped solver.
+//
+// Each leg is assumed to move no faster than its leg_speed px per frame,
+// measured from its box every frame. When a leg beats its bound, the bound
+// is raised and every airborne ball is predicted again. A leg box grown for
+// that speed is also clipped to its character's reach box, the hip plus the
+// summed leg lengths, so a quick kick only widens a box as far as the foot
+// can actually go. Predictions look at most EVENT_HORIZON_FRAMES ahead; one
+// that gets there without touching anything is just made again from there.
+
+#define EVENT_HORIZON_FRAMES 120.0f
+#define EVENT_MIN_LEG_SPEED 0.25f
+#define EVENT_LEG_SPEED_SLACK 2.0f
+#define EVENT_MIN_FLIGHT_FRAMES 2.0f
+#define EVENT_MARGIN 4.0f
+#define EVENT_QUEUE_SLACK 4
+
+typedef enum event_kind {
+    EVENT_IMPACT,
+    EVENT_HORIZON,
+} Event_Kind;
+
+// Heap entry; stale once the ball's stamp has moved on.
+typedef struct flight_event {
+    double time;
+    int32_t ball;
+    uint32_t stamp;
+    int32_t kind;
+} Flight_Event;
+
+typedef struct event_queue {
+    Flight_Event* heap;
+    int count;
+    int capacity;
+    bool* airborne;
+    uint32_t* stamp;
+    Vector2* launch_position;
+    Vector2* launch_velocity;
+    double* launch_time;
+    Rectangle* leg_bounds;
+    float* leg_speed;
+    Rectangle* reach_bounds;
+    int leg_count;
+    int max_balls;
+    int max_characters;
+    double clock;
+    int airborne_count;
+    long long predictions;
+    long long wakes;
+    bool enabled;
+} Event_Queue;
+
+struct world;
+
+size_t event_memory_size(int max_balls, int max_characters);
+bool event_init(Event_Queue* q, Arena* level, int max_balls, int max_characters);
+void event_reset(struct world* w);
+void event_begin_frame(struct world* w, float dt);
+void event_end_frame(struct world* w, float dt);
+
+#endif
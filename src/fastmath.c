@@ -0,0 +1,207 @@
+#include "raylib.h"
+#include <stdio.h>
+#include <math.h>
+#include "main.h"
+#include "fastmath.h"
+
+#define SELF_TEST_SAMPLES (1 << 20)
+#define SELF_TEST_BATCH (MAX_CHARACTERS * LEG_COUNT)
+#define SELF_TEST_REPEATS 20
+
+static void sincos_scalar(const float* x, float* s, float* c, int n)
+{
+    for (int i = 0; i < n; i++) fast_sincosf(x[i], &s[i], &c[i]);
+}
+
+static void atan2_scalar(const float* y, const float* x, float* out, int n)
+{
+    for (int i = 0; i < n; i++) out[i] = fast_atan2f(y[i], x[i]);
+}
+
+#if defined(__SSE2__)
+static void sincos_sse2(const float* x, float* s, float* c, int n)
+{
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128 vs, vc;
+        fast_sincos4(_mm_loadu_ps(x + i), &vs, &vc);
+        _mm_storeu_ps(s + i, vs);
+        _mm_storeu_ps(c + i, vc);
+    }
+    sincos_scalar(x + i, s + i, c + i, n - i);
+}
+
+static void atan2_sse2(const float* y, const float* x, float* out, int n)
+{
+    int i = 0;
+    for (; i + 4 <= n; i += 4) _mm_storeu_ps(out + i, fast_atan2_4(_mm_loadu_ps(y + i), _mm_loadu_ps(x + i)));
+    atan2_scalar(y + i, x + i, out + i, n - i);
+}
+#else
+#define sincos_sse2 NULL
+#define atan2_sse2 NULL
+#endif
+
+#if defined(DISPATCH_AVX2)
+static TARGET_AVX2 void sincos_avx2(const float* x, float* s, float* c, int n)
+{
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256 vs, vc;
+        fast_sincos8(_mm256_loadu_ps(x + i), &vs, &vc);
+        _mm256_storeu_ps(s + i, vs);
+        _mm256_storeu_ps(c + i, vc);
+    }
+    sincos_scalar(x + i, s + i, c + i, n - i);
+}
+
+static TARGET_AVX2 void atan2_avx2(const float* y, const float* x, float* out, int n)
+{
+    int i = 0;
+    for (; i + 8 <= n; i += 8) _mm256_storeu_ps(out + i, fast_atan2_8(_mm256_loadu_ps(y + i), _mm256_loadu_ps(x + i)));
+    atan2_scalar(y + i, x + i, out + i, n - i);
+}
+#else
+#define sincos_avx2 NULL
+#define atan2_avx2 NULL
+#endif
+
+Sincos_Kernel* const fast_sincos_kernels[CPU_LEVEL_COUNT] = {sincos_scalar, sincos_sse2, sincos_avx2};
+Atan2_Kernel* const fast_atan2_kernels[CPU_LEVEL_COUNT] = {atan2_scalar, atan2_sse2, atan2_avx2};
+
+static float random_unit(uint32_t* s)
+{
+    *s = *s * 1664525u + 1013904223u;
+    return (float)(*s >> 8) / 16777216.0f;
+}
+
+// Largest difference from libm over the samples, scalar and dispatched forms.
+static void sincos_error(const float* x, float* s, float* c, int n, double* scalar, double* array)
+{
+    *scalar = *array = 0.0;
+    for (int i = 0; i < n; i++) {
+        float fs, fc;
+        fast_sincosf(x[i], &fs, &fc);
+        *scalar = fmax(*scalar, fmax(fabs(fs - sin(x[i])), fabs(fc - cos(x[i]))));
+    }
+    kernels.sincos(x, s, c, n);
+    for (int i = 0; i < n; i++) *array = fmax(*array, fmax(fabs(s[i] - sin(x[i])), fabs(c[i] - cos(x[i]))));
+}
+
+static void atan2_error(const float* y, const float* x, float* out, int n, double* scalar, double* array)
+{
+    *scalar = *array = 0.0;
+    for (int i = 0; i < n; i++) *scalar = fmax(*scalar, fabs(fast_atan2f(y[i], x[i]) - atan2(y[i], x[i])));
+    kernels.atan2(y, x, out, n);
+    for (int i = 0; i < n; i++) *array = fmax(*array, fabs(out[i] - atan2(y[i], x[i])));
+}
+
+static double ns_per(uint64_t start, int n)
+{
+    return (double)(platform_now_ns() - start) / ((double)n * SELF_TEST_REPEATS);
+}
+
+// Checks the documented error bounds and prints throughput on a batch the
+// size of a full crowd's legs. Returns false if a bound is broken.
+bool fastmath_self_test(void)
+{
+    int n = SELF_TEST_SAMPLES > SELF_TEST_BATCH ? SELF_TEST_SAMPLES : SELF_TEST_BATCH;
+    Arena arena;
+    if (!arena_init(&arena, "self test", 4 * sizeof(float) * (size_t)n + 4 * 16)) {
+        printf("fastmath: out of memory\n");
+        return false;
+    }
+    float* a = ARENA_PUSH_ARRAY(&arena, float, n);
+    float* b = ARENA_PUSH_ARRAY(&arena, float, n);
+    float* s = ARENA_PUSH_ARRAY(&arena, float, n);
+    float* c = ARENA_PUSH_ARRAY(&arena, float, n);
+
+    uint32_t seed = 1;
+    const char* width = cpu_level_names[kernels.level];
+
+    // Half the angles uniform over the valid range, half near the quadrant
+    // boundaries where the reduction is hardest.
+    for (int i = 0; i < n; i++) {
+        float u = random_unit(&seed) * 2.0f - 1.0f;
+        if (i % 2 == 0) a[i] = u * FASTMATH_SINCOS_RANGE;
+        else a[i] = (float)(i % 4096 - 2048) * FASTMATH_PIO2 + u * 1e-3f;
+    }
+    double sincos_scalar, sincos_array;
+    sincos_error(a, s, c, n, &sincos_scalar, &sincos_array);
+
+    // Directions all round the circle at magnitudes from 1e-6 to 1e6.
+    for (int i = 0; i < n; i++) {
+        float r = powf(10.0f, random_unit(&seed) * 12.0f - 6.0f);
+        float t = random_unit(&seed) * 2.0f * FASTMATH_PI;
+        a[i] = r * (float)sin(t);
+        b[i] = r * (float)cos(t);
+    }
+    double atan2_scalar, atan2_array;
+    atan2_error(a, b, s, n, &atan2_scalar, &atan2_array);
+
+    bool ok = sincos_scalar <= FASTMATH_SINCOS_MAX_ERROR && sincos_array <= FASTMATH_SINCOS_MAX_ERROR
+        && atan2_scalar <= FASTMATH_ATAN2_MAX_ERROR && atan2_array <= FASTMATH_ATAN2_MAX_ERROR;
+    printf("fastmath: sincos max error %.3g scalar, %.3g %s (bound %.3g)\n",
+        sincos_scalar, sincos_array, width, FASTMATH_SINCOS_MAX_ERROR);
+    printf("fastmath: atan2 max error %.3g scalar, %.3g %s (bound %.3g)\n",
+        atan2_scalar, atan2_array, width, FASTMATH_ATAN2_MAX_ERROR);
+
+    // Leg rotations as update_joint_positions and rotate_legs see them.
+    int batch = SELF_TEST_BATCH;
+    for (int i = 0; i < batch; i++) a[i] = DEG2RAD * (random_unit(&seed) * 360.0f - 180.0f);
+    volatile float sink = 0.0f;
+    uint64_t t = platform_now_ns();
+    for (int k = 0; k < SELF_TEST_REPEATS; k++) {
+        for (int i = 0; i < batch; i++) {
+            s[i] = sinf(a[i]);
+            c[i] = cosf(a[i]);
+        }
+        sink += s[k] + c[k];
+    }
+    double libm_sincos = ns_per(t, batch);
+    t = platform_now_ns();
+    for (int k = 0; k < SELF_TEST_REPEATS; k++) {
+        for (int i = 0; i < batch; i++) fast_sincosf(a[i], &s[i], &c[i]);
+        sink += s[k] + c[k];
+    }
+    double scalar_sincos = ns_per(t, batch);
+    t = platform_now_ns();
+    for (int k = 0; k < SELF_TEST_REPEATS; k++) {
+        kernels.sincos(a, s, c, batch);
+        sink += s[k] + c[k];
+    }
+    double array_sincos = ns_per(t, batch);
+
+    for (int i = 0; i < batch; i++) {
+        a[i] = random_unit(&seed) * 400.0f - 200.0f;
+        b[i] = random_unit(&seed) * 400.0f - 200.0f;
+    }
+    t = platform_now_ns();
+    for (int k = 0; k < SELF_TEST_REPEATS; k++) {
+        for (int i = 0; i < batch; i++) s[i] = (float)atan2(a[i], b[i]);
+        sink += s[k];
+    }
+    double libm_atan2 = ns_per(t, batch);
+    t = platform_now_ns();
+    for (int k = 0; k < SELF_TEST_REPEATS; k++) {
+        for (int i = 0; i < batch; i++) s[i] = fast_atan2f(a[i], b[i]);
+        sink += s[k];
+    }
+    double scalar_atan2 = ns_per(t, batch);
+    t = platform_now_ns();
+    for (int k = 0; k < SELF_TEST_REPEATS; k++) {
+        kernels.atan2(a, b, s, batch);
+        sink += s[k];
+    }
+    double array_atan2 = ns_per(t, batch);
+    (void)sink;
+
+    printf("fastmath: %d angles, ns each: sincos libm %.2f, scalar %.2f, %s %.2f (%.1fx)\n",
+        batch, libm_sincos, scalar_sincos, width, array_sincos, libm_sincos / array_sincos);
+    printf("fastmath: %d angles, ns each: atan2 libm %.2f, scalar %.2f, %s %.2f (%.1fx)\n",
+        batch, libm_atan2, scalar_atan2, width, array_atan2, libm_atan2 / array_atan2);
+    printf("fastmath: %s\n", ok ? "ok" : "FAILED");
+
+    arena_release(&arena);
+    return ok;
+}
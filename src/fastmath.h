@@ -0,0 +1,190 @@
+#ifndef FASTMATH_H
+#define FASTMATH_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#include "dispatch.h"
+#if defined(DISPATCH_AVX2)
+#include <immintrin.h>
+#endif
+
+// Polynomial sin/cos and atan2 for the transform and IK stages, in float,
+// with no libm calls. Each comes in a scalar form, a 4-wide SSE2 form and an
+// 8-wide AVX2 form that do the same arithmetic lane by lane. The array
+// kernels built on them are picked at startup through dispatch.h.
+//
+// fast_sincosf reduces x by pi/2 in three parts and evaluates the cephes
+// minimax polynomials on [-pi/4, pi/4]. Max abs error against libm double
+// is 1e-7 for |x| <= FASTMATH_SINCOS_RANGE; past it the reduction loses
+// bits.
+//
+// fast_atan2f folds (y, x) into the first octant, reduces by pi/4 above
+// tan(pi/8) with a single division, and evaluates the cephes atanf
+// polynomial. Max abs error is 3e-7 rad over all finite inputs;
+// fast_atan2f(0, 0) is 0.
+//
+// fastmath_self_test checks the bounds above against libm for the scalar
+// form and the dispatched kernels, and times a crowd-sized batch; run it
+// with --self-test.
+
+#define FASTMATH_SINCOS_RANGE 8192.0f
+#define FASTMATH_SINCOS_MAX_ERROR 1.0e-7f
+#define FASTMATH_ATAN2_MAX_ERROR 3.0e-7f
+
+#define FASTMATH_2_OVER_PI 0.636619772367581f
+#define FASTMATH_PIO2_1 1.5703125f
+#define FASTMATH_PIO2_2 4.837512969970703125e-4f
+#define FASTMATH_PIO2_3 7.54978995489188216e-8f
+#define FASTMATH_PI 3.14159265358979f
+#define FASTMATH_PIO2 1.57079632679490f
+#define FASTMATH_PIO4 0.785398163397448f
+#define FASTMATH_TAN_PIO8 0.414213562373095f
+
+#define FASTMATH_SIN_POLY(z, r) ((((-1.9515295891e-4f * (z) + 8.3321608736e-3f) * (z) - 1.6666654611e-1f) * (z)) * (r) + (r))
+#define FASTMATH_COS_POLY(z) \
+    ((((2.443315711809948e-5f * (z) - 1.388731625493765e-3f) * (z) + 4.166664568298827e-2f) * (z)) * (z) - 0.5f * (z) + 1.0f)
+#define FASTMATH_ATAN_POLY(z, r) \
+    (((((8.05374449538e-2f * (z) - 1.38776856032e-1f) * (z) + 1.99777106478e-1f) * (z) - 3.33329491539e-1f) * (z)) * (r) + (r))
+
+static inline void fast_sincosf(float x, float* s, float* c)
+{
+    float t = x * FASTMATH_2_OVER_PI;
+    int q = (int)(t + (t < 0.0f ? -0.5f : 0.5f));
+    float j = (float)q;
+    float r = ((x - j * FASTMATH_PIO2_1) - j * FASTMATH_PIO2_2) - j * FASTMATH_PIO2_3;
+    float z = r * r;
+    float sp = FASTMATH_SIN_POLY(z, r), cp = FASTMATH_COS_POLY(z);
+    // Quadrant q: swap on odd q, then fix the signs, on the bits so the
+    // quadrant never becomes a branch.
+    uint32_t sb, cb;
+    memcpy(&sb, &sp, sizeof sb);
+    memcpy(&cb, &cp, sizeof cb);
+    uint32_t swap = 0u - (uint32_t)(q & 1);
+    uint32_t sv = (sb & ~swap) | (cb & swap), cv = (cb & ~swap) | (sb & swap);
+    sv ^= (uint32_t)(q & 2) << 30;
+    cv ^= (uint32_t)((q + 1) & 2) << 30;
+    memcpy(s, &sv, sizeof sv);
+    memcpy(c, &cv, sizeof cv);
+}
+
+static inline float fast_atan2f(float y, float x)
+{
+    float ax = fabsf(x), ay = fabsf(y);
+    float mx = ax > ay ? ax : ay, mn = ax > ay ? ay : ax;
+    bool big = mn > FASTMATH_TAN_PIO8 * mx;
+    // (mn - mx) / (mn + mx) is tan(atan(mn / mx) - pi/4).
+    float num = big ? mn - mx : mn, den = big ? mn + mx : mx;
+    float r = num / (mx == 0.0f ? 1.0f : den);
+    float a = FASTMATH_ATAN_POLY(r * r, r) + (big ? FASTMATH_PIO4 : 0.0f);
+    a = ay > ax ? FASTMATH_PIO2 - a : a;
+    a = x < 0.0f ? FASTMATH_PI - a : a;
+    a = mx == 0.0f ? 0.0f : a;
+    return y < 0.0f ? -a : a;
+}
+
+#if defined(__SSE2__)
+static inline __m128 fast_select4(__m128 mask, __m128 a, __m128 b)
+{
+    return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+static inline void fast_sincos4(__m128 x, __m128* s, __m128* c)
+{
+    // _mm_cvtps_epi32 rounds to nearest under the default MXCSR mode.
+    __m128i q = _mm_cvtps_epi32(_mm_mul_ps(x, _mm_set1_ps(FASTMATH_2_OVER_PI)));
+    __m128 j = _mm_cvtepi32_ps(q);
+    __m128 r = _mm_sub_ps(x, _mm_mul_ps(j, _mm_set1_ps(FASTMATH_PIO2_1)));
+    r = _mm_sub_ps(r, _mm_mul_ps(j, _mm_set1_ps(FASTMATH_PIO2_2)));
+    r = _mm_sub_ps(r, _mm_mul_ps(j, _mm_set1_ps(FASTMATH_PIO2_3)));
+    __m128 z = _mm_mul_ps(r, r);
+    __m128 sp = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(_mm_sub_ps(_mm_mul_ps(_mm_add_ps(_mm_mul_ps(
+        _mm_set1_ps(-1.9515295891e-4f), z), _mm_set1_ps(8.3321608736e-3f)), z), _mm_set1_ps(1.6666654611e-1f)), z), r), r);
+    __m128 cp = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(_mm_mul_ps(_mm_add_ps(_mm_mul_ps(_mm_sub_ps(_mm_mul_ps(
+        _mm_set1_ps(2.443315711809948e-5f), z), _mm_set1_ps(1.388731625493765e-3f)), z), _mm_set1_ps(4.166664568298827e-2f)), z), z),
+        _mm_mul_ps(_mm_set1_ps(0.5f), z)), _mm_set1_ps(1.0f));
+    __m128 swap = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(q, _mm_set1_epi32(1)), _mm_set1_epi32(1)));
+    __m128 sv = fast_select4(swap, cp, sp), cv = fast_select4(swap, sp, cp);
+    __m128 s_sign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(q, _mm_set1_epi32(2)), 30));
+    __m128 c_sign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(_mm_add_epi32(q, _mm_set1_epi32(1)), _mm_set1_epi32(2)), 30));
+    *s = _mm_xor_ps(sv, s_sign);
+    *c = _mm_xor_ps(cv, c_sign);
+}
+
+static inline __m128 fast_atan2_4(__m128 y, __m128 x)
+{
+    const __m128 sign = _mm_set1_ps(-0.0f);
+    __m128 ax = _mm_andnot_ps(sign, x), ay = _mm_andnot_ps(sign, y);
+    __m128 mx = _mm_max_ps(ax, ay), mn = _mm_min_ps(ax, ay);
+    __m128 zero = _mm_cmpeq_ps(mx, _mm_setzero_ps());
+    __m128 big = _mm_cmpgt_ps(mn, _mm_mul_ps(_mm_set1_ps(FASTMATH_TAN_PIO8), mx));
+    __m128 num = fast_select4(big, _mm_sub_ps(mn, mx), mn);
+    __m128 den = fast_select4(big, _mm_add_ps(mn, mx), mx);
+    __m128 r = _mm_div_ps(num, fast_select4(zero, _mm_set1_ps(1.0f), den));
+    __m128 z = _mm_mul_ps(r, r);
+    __m128 a = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(_mm_sub_ps(_mm_mul_ps(_mm_add_ps(_mm_mul_ps(_mm_sub_ps(_mm_mul_ps(
+        _mm_set1_ps(8.05374449538e-2f), z), _mm_set1_ps(1.38776856032e-1f)), z), _mm_set1_ps(1.99777106478e-1f)), z),
+        _mm_set1_ps(3.33329491539e-1f)), z), r), r);
+    a = _mm_add_ps(a, _mm_and_ps(big, _mm_set1_ps(FASTMATH_PIO4)));
+    a = fast_select4(_mm_cmpgt_ps(ay, ax), _mm_sub_ps(_mm_set1_ps(FASTMATH_PIO2), a), a);
+    a = fast_select4(_mm_cmplt_ps(x, _mm_setzero_ps()), _mm_sub_ps(_mm_set1_ps(FASTMATH_PI), a), a);
+    a = _mm_andnot_ps(zero, a);
+    return _mm_or_ps(a, _mm_and_ps(_mm_cmplt_ps(y, _mm_setzero_ps()), sign));
+}
+#endif
+
+#if defined(DISPATCH_AVX2)
+static inline TARGET_AVX2 void fast_sincos8(__m256 x, __m256* s, __m256* c)
+{
+    __m256i q = _mm256_cvtps_epi32(_mm256_mul_ps(x, _mm256_set1_ps(FASTMATH_2_OVER_PI)));
+    __m256 j = _mm256_cvtepi32_ps(q);
+    __m256 r = _mm256_sub_ps(x, _mm256_mul_ps(j, _mm256_set1_ps(FASTMATH_PIO2_1)));
+    r = _mm256_sub_ps(r, _mm256_mul_ps(j, _mm256_set1_ps(FASTMATH_PIO2_2)));
+    r = _mm256_sub_ps(r, _mm256_mul_ps(j, _mm256_set1_ps(FASTMATH_PIO2_3)));
+    __m256 z = _mm256_mul_ps(r, r);
+    __m256 sp = _mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(_mm256_sub_ps(_mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(
+        _mm256_set1_ps(-1.9515295891e-4f), z), _mm256_set1_ps(8.3321608736e-3f)), z), _mm256_set1_ps(1.6666654611e-1f)), z), r), r);
+    __m256 cp = _mm256_add_ps(_mm256_sub_ps(_mm256_mul_ps(_mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_sub_ps(_mm256_mul_ps(
+        _mm256_set1_ps(2.443315711809948e-5f), z), _mm256_set1_ps(1.388731625493765e-3f)), z), _mm256_set1_ps(4.166664568298827e-2f)), z), z),
+        _mm256_mul_ps(_mm256_set1_ps(0.5f), z)), _mm256_set1_ps(1.0f));
+    __m256 swap = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(q, _mm256_set1_epi32(1)), _mm256_set1_epi32(1)));
+    __m256 sv = _mm256_blendv_ps(sp, cp, swap), cv = _mm256_blendv_ps(cp, sp, swap);
+    __m256 s_sign = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(q, _mm256_set1_epi32(2)), 30));
+    __m256 c_sign = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(_mm256_add_epi32(q, _mm256_set1_epi32(1)), _mm256_set1_epi32(2)), 30));
+    *s = _mm256_xor_ps(sv, s_sign);
+    *c = _mm256_xor_ps(cv, c_sign);
+}
+
+static inline TARGET_AVX2 __m256 fast_atan2_8(__m256 y, __m256 x)
+{
+    const __m256 sign = _mm256_set1_ps(-0.0f);
+    const __m256 zero_v = _mm256_setzero_ps();
+    __m256 ax = _mm256_andnot_ps(sign, x), ay = _mm256_andnot_ps(sign, y);
+    __m256 mx = _mm256_max_ps(ax, ay), mn = _mm256_min_ps(ax, ay);
+    __m256 zero = _mm256_cmp_ps(mx, zero_v, _CMP_EQ_OQ);
+    __m256 big = _mm256_cmp_ps(mn, _mm256_mul_ps(_mm256_set1_ps(FASTMATH_TAN_PIO8), mx), _CMP_GT_OQ);
+    __m256 num = _mm256_blendv_ps(mn, _mm256_sub_ps(mn, mx), big);
+    __m256 den = _mm256_blendv_ps(mx, _mm256_add_ps(mn, mx), big);
+    __m256 r = _mm256_div_ps(num, _mm256_blendv_ps(den, _mm256_set1_ps(1.0f), zero));
+    __m256 z = _mm256_mul_ps(r, r);
+    __m256 a = _mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(_mm256_sub_ps(_mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_sub_ps(_mm256_mul_ps(
+        _mm256_set1_ps(8.05374449538e-2f), z), _mm256_set1_ps(1.38776856032e-1f)), z), _mm256_set1_ps(1.99777106478e-1f)), z),
+        _mm256_set1_ps(3.33329491539e-1f)), z), r), r);
+    a = _mm256_add_ps(a, _mm256_and_ps(big, _mm256_set1_ps(FASTMATH_PIO4)));
+    a = _mm256_blendv_ps(a, _mm256_sub_ps(_mm256_set1_ps(FASTMATH_PIO2), a), _mm256_cmp_ps(ay, ax, _CMP_GT_OQ));
+    a = _mm256_blendv_ps(a, _mm256_sub_ps(_mm256_set1_ps(FASTMATH_PI), a), _mm256_cmp_ps(x, zero_v, _CMP_LT_OQ));
+    a = _mm256_andnot_ps(zero, a);
+    return _mm256_or_ps(a, _mm256_and_ps(_mm256_cmp_ps(y, zero_v, _CMP_LT_OQ), sign));
+}
+#endif
+
+extern Sincos_Kernel* const fast_sincos_kernels[CPU_LEVEL_COUNT];
+extern Atan2_Kernel* const fast_atan2_kernels[CPU_LEVEL_COUNT];
+
+bool fastmath_self_test(void);
+
+#endif
@@ -0,0 +1,38 @@
+#include <string.h>
+#include "histogram.h"
+
+void hist_reset(Histogram* h)
+{
+    memset(h, 0, sizeof(*h));
+}
+
+static uint64_t bucket_highest_value(int index)
+{
+    if (index < HIST_SUB_COUNT) return (uint64_t)index;
+    int shift = index / HIST_SUB_COUNT - 1;
+    uint64_t sub = (uint64_t)(index % HIST_SUB_COUNT) + HIST_SUB_COUNT;
+    return ((sub + 1) << shift) - 1;
+}
+
+uint64_t hist_percentile(const Histogram* h, double percentile)
+{
+    if (h->count == 0) return 0;
+    if (percentile >= 100.0) return h->max;
+
+    uint64_t target = (uint64_t)(percentile / 100.0 * (double)h->count + 0.5);
+    if (target == 0) target = 1;
+    uint64_t seen = 0;
+    for (int i = 0; i < HIST_BUCKET_COUNT; i++) {
+        seen += h->buckets[i];
+        if (seen >= target) {
+            uint64_t v = bucket_highest_value(i);
+            return v > h->max ? h->max : v;
+        }
+    }
+    return h->max;
+}
+
+double hist_mean(const Histogram* h)
+{
+    return h->count ? (double)h->sum / (double)h->count : 0.0;
+}
@@ -0,0 +1,47 @@
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <stdint.h>
+
+// Log-bucketed latency histogram in the style of HdrHistogram. Values below
+// 2^HIST_SUB_BITS get one bucket each; above that every power of two is split
+// into 2^HIST_SUB_BITS linear sub-buckets, so any recorded value is reported
+// within 1/2^HIST_SUB_BITS (about 3%) of its true value. Recording is a clz,
+// a shift and an increment.
+
+#define HIST_SUB_BITS 5
+#define HIST_SUB_COUNT (1 << HIST_SUB_BITS)
+#define HIST_MAX_BITS 40
+#define HIST_BUCKET_COUNT ((HIST_MAX_BITS - HIST_SUB_BITS + 1) * HIST_SUB_COUNT)
+
+typedef struct histogram {
+    uint64_t count;
+    uint64_t min;
+    uint64_t max;
+    uint64_t sum;
+    uint32_t buckets[HIST_BUCKET_COUNT];
+} Histogram;
+
+void hist_reset(Histogram* h);
+uint64_t hist_percentile(const Histogram* h, double percentile);
+double hist_mean(const Histogram* h);
+
+static inline int hist_bucket_index(uint64_t v)
+{
+    if (v >= (1ull << HIST_MAX_BITS)) v = (1ull << HIST_MAX_BITS) - 1;
+    if (v < HIST_SUB_COUNT) return (int)v;
+    int e = 63 - __builtin_clzll(v);
+    int shift = e - HIST_SUB_BITS;
+    return (shift + 1) * HIST_SUB_COUNT + (int)((v >> shift) - HIST_SUB_COUNT);
+}
+
+static inline void hist_record(Histogram* h, uint64_t v)
+{
+    h->buckets[hist_bucket_index(v)]++;
+    if (h->count == 0 || v < h->min) h->min = v;
+    if (v > h->max) h->max = v;
+    h->sum += v;
+    h->count++;
+}
+
+#endif
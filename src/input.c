@@ -0,0 +1,81 @@
+#include "input.h"
+#include "platform.h"
+
+// raylib links GLFW in but does not ship its header.
+typedef struct GLFWwindow GLFWwindow;
+typedef void (*GLFWcursorposfun)(GLFWwindow* window, double x, double y);
+GLFWwindow* glfwGetCurrentContext(void);
+GLFWcursorposfun glfwSetCursorPosCallback(GLFWwindow* window, GLFWcursorposfun callback);
+void glfwWaitEventsTimeout(double timeout);
+void glfwWaitEvents(void);
+
+Input_Ring input_ring;
+
+static GLFWcursorposfun raylib_cursor_callback;
+
+static void cursor_callback(GLFWwindow* window, double x, double y)
+{
+    input_record(platform_now_ns(), (float)x, (float)y);
+    if (raylib_cursor_callback != NULL) raylib_cursor_callback(window, x, y);
+}
+
+bool input_init(void)
+{
+    GLFWwindow* window = glfwGetCurrentContext();
+    if (window == NULL) return false;
+    raylib_cursor_callback = glfwSetCursorPosCallback(window, cursor_callback);
+    return true;
+}
+
+void input_record(uint64_t time_ns, float x, float y)
+{
+    Input_Sample* s = &input_ring.samples[input_ring.head++ & (INPUT_RING_SIZE - 1)];
+    s->time_ns = time_ns;
+    s->x = x;
+    s->y = y;
+}
+
+// Linear interpolation along the recorded cursor path. Times after the newest
+// sample hold its position; times before the oldest retained sample clamp to
+// that sample.
+void input_position_at(uint64_t time_ns, float* x, float* y)
+{
+    uint32_t head = input_ring.head;
+    if (head == 0) return;
+
+    uint32_t count = head < INPUT_RING_SIZE ? head : INPUT_RING_SIZE;
+    const Input_Sample* newer = &input_ring.samples[(head - 1) & (INPUT_RING_SIZE - 1)];
+    if (time_ns >= newer->time_ns) {
+        *x = newer->x;
+        *y = newer->y;
+        return;
+    }
+    for (uint32_t i = 2; i <= count; i++) {
+        const Input_Sample* older = &input_ring.samples[(head - i) & (INPUT_RING_SIZE - 1)];
+        if (older->time_ns <= time_ns) {
+            float t = (float)(time_ns - older->time_ns) / (float)(newer->time_ns - older->time_ns);
+            *x = older->x + (newer->x - older->x) * t;
+            *y = older->y + (newer->y - older->y) * t;
+            return;
+        }
+        newer = older;
+    }
+    *x = newer->x;
+    *y = newer->y;
+}
+
+void input_wait_until(uint64_t deadline_ns)
+{
+    for (;;) {
+        uint64_t now = platform_now_ns();
+        if (now >= deadline_ns) return;
+        glfwWaitEventsTimeout((double)(deadline_ns - now) * 1e-9);
+    }
+}
+
+// Events handled here land in raylib's input state through its callbacks, so
+// the next frame sees them as pressed keys or mouse motion as usual.
+void input_wait_event(void)
+{
+    glfwWaitEvents();
+}
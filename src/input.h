@@ -0,0 +1,37 @@
+#ifndef INPUT_H
+#define INPUT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Sub-frame mouse input. raylib only samples the cursor once per frame, so we
+// chain our own GLFW cursor callback in front of raylib's and stamp every raw
+// cursor event with the monotonic clock into a ring buffer. Between frames,
+// input_wait_until blocks on GLFW events instead of sleeping, so events are
+// stamped when they arrive rather than when the next frame polls them. The
+// simulation then reads the cursor path at any instant with input_position_at.
+// input_wait_event blocks until any window event at all, for an idle app.
+
+#define INPUT_RING_SIZE 1024
+#define PHYSICS_SUBSTEPS 4
+
+typedef struct input_sample {
+    uint64_t time_ns;
+    float x;
+    float y;
+} Input_Sample;
+
+typedef struct input_ring {
+    Input_Sample samples[INPUT_RING_SIZE];
+    uint32_t head;
+} Input_Ring;
+
+extern Input_Ring input_ring;
+
+bool input_init(void);
+void input_record(uint64_t time_ns, float x, float y);
+void input_position_at(uint64_t time_ns, float* x, float* y);
+void input_wait_until(uint64_t deadline_ns);
+void input_wait_event(void);
+
+#endif
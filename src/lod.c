@@ -0,0 +1,194 @@
+#include "raylib.h"
+#include "raymath.h"
+#include <float.h>
+#include <math.h>
+#include "main.h"
+#include "lod.h"
+
+const int lod_ik_iterations[LOD_TIER_COUNT] = {IK_ITERATIONS, LOD_REDUCED_ITERATIONS, 0};
+// Periods must be powers of two; lod_due masks with period - 1.
+const int lod_period[LOD_TIER_COUNT] = {1, 2, 4};
+
+size_t lod_memory_size(int character_count)
+{
+    return (size_t)character_count * sizeof(uint8_t) + 16;
+}
+
+bool lod_init(Lod_System* l, Arena* level, int character_count)
+{
+    *l = (Lod_System) {.character_count = character_count, .budget_ns = LOD_FRAME_BUDGET_NS};
+    l->tier = ARENA_PUSH_ARRAY(level, uint8_t, character_count);
+    if (l->tier == NULL) return false;
+    for (int c = 0; c < character_count; c++) l->tier[c] = LOD_FULL;
+    return true;
+}
+
+// Balls bucketed into square cells over their bounding box, rebuilt from
+// the frame arena on every lod_assign.
+typedef struct ball_grid {
+    float min_x;
+    float min_y;
+    float inv_cell;
+    float cell;
+    int cells_x;
+    int cells_y;
+    int* cell_start;
+    float* x;
+    float* y;
+} Ball_Grid;
+
+static bool ball_grid_build(Ball_Grid* g, const World* w)
+{
+    int n = w->ball_count;
+    float min_x = FLT_MAX, min_y = FLT_MAX, max_x = -FLT_MAX, max_y = -FLT_MAX;
+    for (int b = 0; b < n; b++) {
+        Vector2 p = w->balls[b].centre_position;
+        min_x = fminf(min_x, p.x);
+        min_y = fminf(min_y, p.y);
+        max_x = fmaxf(max_x, p.x);
+        max_y = fmaxf(max_y, p.y);
+    }
+    // About LOD_GRID_BALLS_PER_CELL balls to a cell, so a dense drill keeps
+    // cells small and scattered balls keep the search to a few cells; then
+    // coarser if that would exceed LOD_GRID_MAX_CELLS.
+    float area = fmaxf(max_x - min_x, 1.0f) * fmaxf(max_y - min_y, 1.0f);
+    float cell = sqrtf(area * LOD_GRID_BALLS_PER_CELL / (float)n);
+    cell = fminf(fmaxf(cell, LOD_GRID_MIN_CELL), LOD_CONTACT_RADIUS);
+    while ((max_x - min_x) / cell * ((max_y - min_y) / cell) > LOD_GRID_MAX_CELLS) cell *= 2.0f;
+    *g = (Ball_Grid) {
+        .min_x = min_x,
+        .min_y = min_y,
+        .cell = cell,
+        .inv_cell = 1.0f / cell,
+        .cells_x = (int)((max_x - min_x) / cell) + 1,
+        .cells_y = (int)((max_y - min_y) / cell) + 1,
+    };
+    int cells = g->cells_x * g->cells_y;
+    g->cell_start = ARENA_PUSH_ARRAY(w->scratch, int, cells + 1);
+    int* cell_of = ARENA_PUSH_ARRAY(w->scratch, int, n);
+    g->x = ARENA_PUSH_ARRAY(w->scratch, float, n);
+    g->y = ARENA_PUSH_ARRAY(w->scratch, float, n);
+    if (g->cell_start == NULL || cell_of == NULL || g->x == NULL || g->y == NULL) return false;
+
+    // Counting sort by cell, positions copied out so a cell is contiguous.
+    for (int c = 0; c <= cells; c++) g->cell_start[c] = 0;
+    for (int b = 0; b < n; b++) {
+        Vector2 p = w->balls[b].centre_position;
+        int cx = (int)((p.x - min_x) * g->inv_cell);
+        int cy = (int)((p.y - min_y) * g->inv_cell);
+        cell_of[b] = cy * g->cells_x + cx;
+        g->cell_start[cell_of[b] + 1]++;
+    }
+    for (int c = 0; c < cells; c++) g->cell_start[c + 1] += g->cell_start[c];
+    for (int b = 0; b < n; b++) {
+        int at = g->cell_start[cell_of[b]]++;
+        g->x[at] = w->balls[b].centre_position.x;
+        g->y[at] = w->balls[b].centre_position.y;
+    }
+    for (int c = cells; c > 0; c--) g->cell_start[c] = g->cell_start[c - 1];
+    g->cell_start[0] = 0;
+    return true;
+}
+
+// Lowers best to the nearest ball in cells [x0, x1] x [y0, y1], clipped to
+// the grid, skipping cells that cannot beat it.
+static void ball_grid_scan(const Ball_Grid* g, Vector2 p, int x0, int x1, int y0, int y1, float* best)
+{
+    if (x0 < 0) x0 = 0;
+    if (y0 < 0) y0 = 0;
+    if (x1 >= g->cells_x) x1 = g->cells_x - 1;
+    if (y1 >= g->cells_y) y1 = g->cells_y - 1;
+    for (int y = y0; y <= y1; y++) {
+        float cell_y0 = g->min_y + (float)y * g->cell;
+        float ey = fmaxf(0.0f, fmaxf(cell_y0 - p.y, p.y - (cell_y0 + g->cell)));
+        for (int x = x0; x <= x1; x++) {
+            float cell_x0 = g->min_x + (float)x * g->cell;
+            float ex = fmaxf(0.0f, fmaxf(cell_x0 - p.x, p.x - (cell_x0 + g->cell)));
+            if (ex * ex + ey * ey >= *best) continue;
+            int c = y * g->cells_x + x;
+            for (int i = g->cell_start[c]; i < g->cell_start[c + 1]; i++) {
+                float dx = g->x[i] - p.x, dy = g->y[i] - p.y;
+                float d = dx * dx + dy * dy;
+                if (d < *best) *best = d;
+            }
+        }
+    }
+}
+
+// Squared distance from p to the nearest ball, or FLT_MAX if none is closer
+// than limit. The cells around p usually give a close ball at once, and only
+// the cells within that distance are searched after it. Once a ball is
+// within near the exact distance no longer matters to the caller, so the
+// second pass is skipped.
+static float ball_grid_nearest(const Ball_Grid* g, Vector2 p, float near, float limit)
+{
+    float gx = (p.x - g->min_x) * g->inv_cell;
+    float gy = (p.y - g->min_y) * g->inv_cell;
+    // Distance from p to the grid box, which every ball is inside.
+    float out_x = fmaxf(0.0f, fmaxf(-gx, gx - (float)g->cells_x));
+    float out_y = fmaxf(0.0f, fmaxf(-gy, gy - (float)g->cells_y));
+    if ((out_x * out_x + out_y * out_y) * g->cell * g->cell >= limit * limit) return FLT_MAX;
+
+    float best = limit * limit;
+    int cx = (int)floorf(gx), cy = (int)floorf(gy);
+    ball_grid_scan(g, p, cx - 1, cx + 1, cy - 1, cy + 1, &best);
+    if (best >= near * near) {
+        float r = sqrtf(best) * g->inv_cell;
+        ball_grid_scan(g, p, (int)floorf(gx - r), (int)floorf(gx + r), (int)floorf(gy - r), (int)floorf(gy + r), &best);
+    }
+    return best < limit * limit ? best : FLT_MAX;
+}
+
+void lod_assign(World* w)
+{
+    Lod_System* l = &w->lod;
+    int selected = w->selected_joint != -1 ? joint_character(w, w->selected_joint) : -1;
+    const float margin = LOD_CONTACT_RADIUS - BALL_RADIUS;
+
+    size_t mark = arena_mark(w->scratch);
+    Ball_Grid grid = {0};
+    bool have_grid = w->ball_count >= LOD_GRID_MIN_BALLS && ball_grid_build(&grid, w);
+
+    for (int t = 0; t < LOD_TIER_COUNT; t++) l->tier_count[t] = 0;
+    for (int c = 0; c < w->character_count; c++) {
+        Vector2 hip = w->joints[w->characters[c].first_joint].centre_position;
+        float d2 = FLT_MAX;
+        if (have_grid) {
+            d2 = ball_grid_nearest(&grid, hip, LOD_FULL_RADIUS, LOD_CONTACT_RADIUS);
+        } else {
+            for (int b = 0; b < w->ball_count; b++) {
+                float d = Vector2DistanceSqr(hip, w->balls[b].centre_position);
+                if (d < d2) d2 = d;
+            }
+        }
+        bool in_reach = d2 < LOD_CONTACT_RADIUS * LOD_CONTACT_RADIUS;
+        bool on_screen = hip.x > -margin && hip.x < WIDTH + margin && hip.y > -margin && hip.y < HEIGHT + margin;
+
+        int tier = d2 < LOD_FULL_RADIUS * LOD_FULL_RADIUS ? LOD_FULL : in_reach ? LOD_REDUCED : LOD_ANIM;
+        if (!on_screen && !in_reach) tier = LOD_ANIM;
+        tier += l->bias;
+        if (tier > LOD_ANIM) tier = LOD_ANIM;
+        if (in_reach && tier > LOD_REDUCED) tier = LOD_REDUCED;
+        if (c == selected) tier = LOD_FULL;
+
+        l->tier[c] = (uint8_t)tier;
+        l->tier_count[tier]++;
+    }
+    arena_rewind(w->scratch, mark);
+}
+
+void lod_end_frame(Lod_System* l, uint64_t managed_ns)
+{
+    if (managed_ns > l->budget_ns) {
+        if (l->bias < LOD_ANIM) l->bias++;
+        l->calm_frames = 0;
+    } else if (managed_ns < l->budget_ns / 2 && l->bias > 0) {
+        if (++l->calm_frames >= LOD_RELAX_FRAMES) {
+            l->bias--;
+            l->calm_frames = 0;
+        }
+    } else {
+        l->calm_frames = 0;
+    }
+    l->frame++;
+}
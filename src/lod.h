@@ -0,0 +1,74 @@
+#ifndef LOD_H
+#define LOD_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "arena.h"
+
+// Crowd level of detail. Every frame each character gets a tier from whether
+// it is on screen and how far its hip is from the nearest ball:
+//
+//     LOD_FULL      near a ball: IK_ITERATIONS solver iterations every frame
+//     LOD_REDUCED   within leg reach of a ball: LOD_REDUCED_ITERATIONS,
+//                   every second frame
+//     LOD_ANIM      out of reach or off screen: animation only, every fourth
+//                   frame, and its legs are left out of ball collision
+//
+// Lower tiers update on staggered frames, (frame + character) % period, so
+// the work is spread evenly instead of landing on one frame. The caller
+// reports how long the LOD-managed stages took; over LOD_FRAME_BUDGET_NS the
+// bias demotes every character one more tier, and after LOD_RELAX_FRAMES
+// comfortably under budget it is relaxed again. Characters within leg reach
+// of a ball are never demoted past LOD_REDUCED, so demotion never lets a ball
+// pass through a leg.
+//
+// The nearest ball to each hip comes from a grid of squares sized to hold a
+// few balls each, built over the balls every frame: the cells around the hip
+// give a first distance and only cells within it are searched after, so a
+// big crowd costs a few cells per character rather than every ball. Below
+// LOD_GRID_MIN_BALLS a plain scan is cheaper than building the grid.
+
+#define LOD_FULL_RADIUS 250.0f
+#define LOD_CONTACT_RADIUS 450.0f
+#define LOD_REDUCED_ITERATIONS 8
+#define LOD_FRAME_BUDGET_NS 4000000ull
+#define LOD_RELAX_FRAMES 60
+#define LOD_GRID_MIN_BALLS 128
+#define LOD_GRID_MIN_CELL 16.0f
+#define LOD_GRID_BALLS_PER_CELL 4.0f
+#define LOD_GRID_MAX_CELLS 65536
+
+typedef enum lod_tier {
+    LOD_FULL,
+    LOD_REDUCED,
+    LOD_ANIM,
+    LOD_TIER_COUNT
+} Lod_Tier;
+
+typedef struct lod_system {
+    uint8_t* tier;
+    int character_count;
+    uint32_t frame;
+    int bias;
+    int calm_frames;
+    uint64_t budget_ns;
+    int tier_count[LOD_TIER_COUNT];
+} Lod_System;
+
+struct world;
+
+extern const int lod_ik_iterations[LOD_TIER_COUNT];
+extern const int lod_period[LOD_TIER_COUNT];
+
+size_t lod_memory_size(int character_count);
+bool lod_init(Lod_System* l, Arena* level, int character_count);
+void lod_assign(struct world* w);
+void lod_end_frame(Lod_System* l, uint64_t managed_ns);
+
+// True on the frames where character c's tier lets it update.
+static inline bool lod_due(const Lod_System* l, int c)
+{
+    return ((l->frame + (uint32_t)c) & (uint32_t)(lod_period[l->tier[c]] - 1)) == 0;
+}
+
+#endif
@@ -1,32 +1,109 @@
 #include "raylib.h"
 #include "raymath.h"
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <stdbool.h>
 #include <math.h>
 #include "main.h"
+#include "profiler.h"
+#include "platform.h"
+#include "scene.h"
+#include "input.h"
+#include "telemetry.h"
 
-Leg_Element thigh;
-Leg_Element leg;
-Leg_Element foot;
-Joint_Element hip;
-Joint_Element knee;
-Joint_Element ankle;
-Joint_Element toe;
+Vector2 get_leg_origin(Leg_Element* l)
+{
+    Vector2 v = (Vector2) {.x = l->shape.width, .y = 0};
+    return v;
+}
 
-Ball ball;
+size_t world_memory_size(int max_characters, int max_balls)
+{
+    size_t joints = (size_t)max_characters * JOINT_COUNT;
+    size_t legs = (size_t)max_characters * LEG_COUNT;
+    // One alignment's worth of slack per array.
+    return joints * sizeof(Joint_Element)
+        + legs * (sizeof(Leg_Element) + sizeof(Leg_Points) + sizeof(Leg_Render))
+        + (size_t)max_balls * sizeof(Ball)
+        + (size_t)max_characters * sizeof(Character)
+        + world_runtime_memory_size(max_characters, max_balls)
+        + 6 * 32;
+}
 
-Joint_Element* joints_array[JOINT_COUNT];
-Leg_Element* legs_array[3];
+// Per-level state that is never saved in a scene: the picking grid, the
+// animation players, the pose blend layers, the crowd LOD tiers, the
+// solver's list of driven characters, the ball and leg contact caches, the
+// leg tree, the flight event queue and the trajectory cache.
+size_t world_runtime_memory_size(int max_characters, int max_balls)
+{
+    return pick_memory_size(max_characters * JOINT_COUNT) + anim_memory_size(max_characters)
+        + blend_memory_size(max_characters * LEG_COUNT) + lod_memory_size(max_characters)
+        + xpbd_memory_size(max_characters) + contact_memory_size(max_balls)
+        + leg_manifold_memory_size(max_balls) + bvh_memory_size(max_characters * LEG_COUNT)
+        + event_memory_size(max_balls, max_characters)
+        + trajectory_memory_size();
+}
 
-int selected_joint;
+bool world_init_runtime(World* w, Arena* level, int max_characters)
+{
+    w->hovered_joint = -1;
+    return pick_init(&w->pick, level, max_characters * JOINT_COUNT)
+        && anim_init(&w->anim, level, max_characters)
+        && blend_init(&w->blend, level, max_characters * LEG_COUNT)
+        && lod_init(&w->lod, level, max_characters)
+        && xpbd_init(&w->xpbd, level, max_characters)
+        && contact_init(&w->ball_contacts, level, w->max_balls)
+        && leg_manifold_init(&w->leg_contacts, level, w->max_balls)
+        && bvh_init(&w->leg_tree, level, max_characters * LEG_COUNT)
+        && event_init(&w->events, level, w->max_balls, max_characters)
+        && trajectory_init(&w->trajectories, level)
+        && anim_add_kick_clip(&w->anim) != -1;
+}
 
-Vector2 get_leg_origin(Leg_Element* l)
+bool world_init(World* w, Arena* level, Arena* scratch, int max_characters, int max_balls)
 {
-    Vector2 v = (Vector2) {.x = l->shape.width, .y = 0};
-    return v;
+    *w = (World) {0};
+    w->joints = ARENA_PUSH_ARRAY(level, Joint_Element, max_characters * JOINT_COUNT);
+    w->legs = ARENA_PUSH_ARRAY(level, Leg_Element, max_characters * LEG_COUNT);
+    w->leg_points = ARENA_PUSH_ARRAY(level, Leg_Points, max_characters * LEG_COUNT);
+    w->leg_render = ARENA_PUSH_ARRAY(level, Leg_Render, max_characters * LEG_COUNT);
+    w->balls = ARENA_PUSH_ARRAY(level, Ball, max_balls);
+    w->characters = ARENA_PUSH_ARRAY(level, Character, max_characters);
+    w->max_characters = max_characters;
+    w->max_balls = max_balls;
+    w->selected_joint = -1;
+    w->hovered_joint = -1;
+    w->scratch = scratch;
+
+    return w->joints != NULL && w->legs != NULL && w->leg_points != NULL
+        && w->leg_render != NULL && w->balls != NULL && w->characters != NULL
+        && world_init_runtime(w, level, max_characters);
 }
 
-Leg_Element make_leg_element(Joint_Element* origin, float width, float height)
+// Throws away the current level and builds the default scene: a crowd of
+// character_count legs and one ball. Everything comes out of the level arena,
+// so a reload never touches the heap.
+bool load_level(World* w, Arena* level, Arena* scratch, int character_count)
+{
+    arena_reset(level);
+    if (!world_init(w, level, scratch, character_count, MAX_BALLS)) return false;
+
+    for (int c = 0; c < character_count; c++) {
+        Vector2 hip = {
+            .x = WIDTH - (c % CROWD_COLUMNS) * CROWD_SPACING,
+            .y = 500 - (c / CROWD_COLUMNS % CROWD_COLUMNS) * CROWD_SPACING
+        };
+        add_character(w, hip, NULL);
+    }
+    add_ball(w, (Vector2){WIDTH * 0.5f, HEIGHT * 0.5f});
+    update_joint_positions(w);
+    pick_rebuild(&w->pick, w);
+
+    return true;
+}
+
+Leg_Element make_leg_element(World* w, int origin, float width, float height)
 {
     Leg_Element l;
     l.origin = origin;
@@ -34,21 +111,13 @@ Leg_Element make_leg_element(Joint_Element* origin, float width, float height)
     l.shape.height = height;
     l.rotation = 0.0f;
 
-    l.shape.x = l.origin->centre_position.x;
-    l.shape.y = l.origin->centre_position.y;
-
-    l.centre_pos = (Vector2) {
-        .x = l.shape.x + (0.5f * l.shape.width),
-        .y = l.shape.y + (0.5f * l.shape.height)
-    };
-    l.color = RED;
-    l.selected = false;
-    l.leg_points = (Leg_Points) {0};
+    l.shape.x = w->joints[origin].centre_position.x;
+    l.shape.y = w->joints[origin].centre_position.y;
 
     return l;
 }
 
-Joint_Element make_joint_element(Leg_Element* from, Leg_Element* to, float radius)
+Joint_Element make_joint_element(World* w, int from, int to, float radius)
 {
     Joint_Element j;
     j = (Joint_Element) {
@@ -56,303 +125,793 @@ Joint_Element make_joint_element(Leg_Element* from, Leg_Element* to, float radiu
         .connects_to = to,
         .radius = radius,
     };
-    if (from != NULL) {
-        Vector2 origin_offset = get_leg_origin(from);
+    if (from != -1) {
+        Leg_Element* l = &w->legs[from];
+        Vector2 origin_offset = get_leg_origin(l);
          j.centre_position = (Vector2) {
-            .x = from->shape.x + origin_offset.x,
-            .y = from->shape.y + origin_offset.y
+            .x = l->shape.x + origin_offset.x,
+            .y = l->shape.y + origin_offset.y
         };
     }
 
     return j;
 }
 
-void select_joint(Joint_Element** joints)
+const Vector2 default_leg_sizes[LEG_COUNT] = {
+    {120.0f, 50.0f},    // thigh
+    {50.0f, 160.0f},    // leg
+    {75.0f, 30.0f},     // foot
+};
+
+// Appends one hip-knee-ankle-toe chain with the given thigh, leg and foot
+// sizes, or default_leg_sizes when sizes is NULL. The joints and legs of a
+// character are contiguous, so character c owns joints
+// [c * JOINT_COUNT, (c + 1) * JOINT_COUNT) and legs [c * LEG_COUNT, (c + 1) * LEG_COUNT).
+int add_character(World* w, Vector2 hip_position, const Vector2* sizes)
+{
+    if (w->character_count >= w->max_characters) return -1;
+    if (sizes == NULL) sizes = default_leg_sizes;
+
+    int c = w->character_count++;
+    int j0 = w->joint_count;
+    int l0 = w->leg_count;
+    w->characters[c] = (Character) {.first_joint = j0, .first_leg = l0};
+
+    w->joints[j0] = make_joint_element(w, -1, l0, JOINT_RADIUS);
+    w->joints[j0].centre_position = hip_position;
+    for (int i = 0; i < LEG_COUNT; i++) {
+        w->legs[l0 + i] = make_leg_element(w, j0 + i, sizes[i].x, sizes[i].y);
+        w->leg_points[l0 + i] = (Leg_Points) {0};
+        w->leg_render[l0 + i] = (Leg_Render) {.color = RED, .selected = false};
+        int to = (i + 1 < LEG_COUNT) ? l0 + i + 1 : -1;
+        w->joints[j0 + i + 1] = make_joint_element(w, l0 + i, to, JOINT_RADIUS);
+    }
+    w->joint_count += JOINT_COUNT;
+    w->leg_count += LEG_COUNT;
+
+    return c;
+}
+
+int add_ball(World* w, Vector2 position)
+{
+    if (w->ball_count >= w->max_balls) return -1;
+    int b = w->ball_count++;
+    w->balls[b] = (Ball) {
+        .centre_position = position,
+        .velocity = (Vector2){0,0},
+        .radius = BALL_RADIUS,
+        .hit = false
+    };
+    return b;
+}
+
+int joint_character(World* w, int joint)
+{
+    (void)w;
+    return joint / JOINT_COUNT;
+}
+
+void select_joint(World* w)
 {
     if (!IsMouseButtonPressed(MOUSE_BUTTON_LEFT)) return;
 
     Vector2 mouse_pos = GetMousePosition();
+    int hit = pick_nearest(&w->pick, w, mouse_pos.x, mouse_pos.y, JOINT_RADIUS);
 
-    for (int i = 1; i < 4; i++) {
-        if (joints[i]->connects_from == NULL) continue;
-        if (CheckCollisionPointCircle(mouse_pos, joints[i]->centre_position, JOINT_RADIUS)) {
-            if (selected_joint != -1) {
-                joints_array[selected_joint]->connects_from->selected = false;
-            }
-            joints[i]->connects_from->selected = true;
-            selected_joint = i;
-            return;
-        }
+    if (w->selected_joint != -1) {
+        w->leg_render[w->joints[w->selected_joint].connects_from].selected = false;
+        w->selected_joint = -1;
     }
-    if (selected_joint != -1) {
-        joints_array[selected_joint]->connects_from->selected = false;
-        selected_joint = -1;
+    if (hit != -1) {
+        w->leg_render[w->joints[hit].connects_from].selected = true;
+        w->selected_joint = hit;
     }
 }
 
-void move_leg(Leg_Element* l) 
+// Refits the picking grid to this frame's joint positions, then updates the
+// hovered joint and the right-drag box selection.
+void update_picking(World* w)
 {
-    Vector2 mouse_d = GetMouseDelta();
-    //printf("x %f y %f\n", mouse_d.x, mouse_d.y);
-    if (mouse_d.y > 0) {
-        l->rotation -= 0.25f * mouse_d.y;
-    } else if (mouse_d.y < 0) {
-        l->rotation += 0.25 * -mouse_d.y;
+    static Vector2 box_start;
+    pick_refit(&w->pick, w);
+
+    Vector2 mouse_pos = GetMousePosition();
+    w->hovered_joint = pick_nearest(&w->pick, w, mouse_pos.x, mouse_pos.y, JOINT_RADIUS);
+
+    if (IsMouseButtonPressed(MOUSE_BUTTON_RIGHT)) box_start = mouse_pos;
+    if (IsMouseButtonReleased(MOUSE_BUTTON_RIGHT)) {
+        pick_box(&w->pick, w, box_start.x, box_start.y, mouse_pos.x, mouse_pos.y);
     }
 }
 
-void handle_leg_elements(Leg_Element** legs)
+void move_leg(World* w, int leg, float mouse_dy)
 {
-    for (int i = 0; i < 3; i++) {
-        if (legs[i]->selected) {
-            legs[i]->color = BLUE;
-            move_leg(legs[i]);
+    // A delta on top of the clip and IK, not an absolute rotation.
+    blend_set(&w->blend, BLEND_MANUAL, leg, -0.25f * mouse_dy, 1.0f);
+}
+
+// mouse_dy is the vertical cursor travel covered by this (sub)step.
+void handle_leg_elements(World* w, float mouse_dy)
+{
+    for (int i = 0; i < w->leg_count; i++) {
+        Leg_Render* r = &w->leg_render[i];
+        if (r->selected) {
+            r->color = BLUE;
+            move_leg(w, i, mouse_dy);
         } else {
-            legs[i]->color = RED;
+            r->color = RED;
         }
     }
 }
 
-void solve_leg_chain(Vector2 target, Joint_Element** joints, int joint_count)
+Vector2 get_rotated_end(Leg_Element* l)
 {
-    Vector2 positions[JOINT_COUNT];
-    for (int i = 0; i < joint_count; i++) {
-        positions[i] = joints[i]->centre_position;
-    }
-    Vector2 fixed_start = positions[0];
-    Vector2 t = target;
+    float dx = -l->shape.width;
+    float dy = l->shape.height;
+    float s, c;
+    fast_sincosf(DEG2RAD * l->rotation, &s, &c);
+    return (Vector2) {dx * c - dy * s, dx * s + dy * c};
+}
 
-    float lengths[JOINT_COUNT - 1];
-    float total_length = 0.0f;
-    for (int i = 0; i < joint_count - 1; i++) {
-        Leg_Element* l = joints[i]->connects_to;
-        float len = Vector2Length((Vector2) {l->shape.width, l->shape.height});
-        lengths[i] = len;
-        total_length += len;
+void update_joint_positions(World* w)
+{
+    bool moved = false;
+    // Sines and cosines for a block of joints at once; rotations do not
+    // change during the pass, only the positions chained down the legs.
+    float angle[TRANSFORM_BLOCK], sin_a[TRANSFORM_BLOCK], cos_a[TRANSFORM_BLOCK];
+    for (int first = 0; first < w->joint_count; first += TRANSFORM_BLOCK) {
+        int n = w->joint_count - first < TRANSFORM_BLOCK ? w->joint_count - first : TRANSFORM_BLOCK;
+        for (int k = 0; k < n; k++) {
+            int from = w->joints[first + k].connects_from;
+            angle[k] = from == -1 ? 0.0f : DEG2RAD * w->legs[from].rotation;
+        }
+        kernels.sincos(angle, sin_a, cos_a, n);
+
+        for (int k = 0; k < n; k++) {
+            Joint_Element* j = &w->joints[first + k];
+            if (j->connects_from == -1) continue;
+            Leg_Element* l = &w->legs[j->connects_from];
+            Leg_Points* lp = &w->leg_points[j->connects_from];
+            Leg_Points old = *lp;
+            float s = sin_a[k], c = cos_a[k];
+            float width = l->shape.width, height = l->shape.height;
+            Vector2 tr = {l->shape.x, l->shape.y};
+            // The far end of the leg, rotated: where the next joint sits.
+            Vector2 end = {-width * c - height * s, -width * s + height * c};
+            lp->top_right = tr;
+            lp->top_left = (Vector2) {tr.x - width * c, tr.y - width * s};
+            lp->bot_left = (Vector2) {tr.x + end.x, tr.y + end.y};
+            lp->bot_right = (Vector2) {tr.x - height * s, tr.y + height * c};
+            if (memcmp(&old, lp, sizeof old) != 0) {
+                moved = true;
+                bvh_move_leg(&w->leg_tree, j->connects_from, lp);
+            }
+
+            j->centre_position = lp->bot_left;
+            if (j->connects_to != -1) {
+                Leg_Element* ll = &w->legs[j->connects_to];
+                ll->shape.x = j->centre_position.x;
+                ll->shape.y = j->centre_position.y;
+            }
+        }
     }
+    if (moved) w->pose_version++;
+}
 
-    float len_to_target = Vector2Length(Vector2Subtract(t, positions[0]));
-    if (len_to_target > total_length) {
-        Vector2 dir = Vector2Subtract(t, positions[2]);
-        dir = Vector2Normalize(dir);
-        positions[JOINT_COUNT - 1] = Vector2Add(Vector2Scale(dir, lengths[2]), positions[2]);
+void rotate_legs(World* w, int character)
+{
+    Joint_Element* joints = &w->joints[w->characters[character].first_joint];
+    float angle[JOINT_COUNT - 1], sin_a[JOINT_COUNT - 1], cos_a[JOINT_COUNT - 1];
+    float dy[JOINT_COUNT - 1], dx[JOINT_COUNT - 1], aim[JOINT_COUNT - 1];
+    for (int i = 0; i < JOINT_COUNT - 1; i++) {
+        int leg = joints[i].connects_to;
+        angle[i] = leg == -1 ? 0.0f : DEG2RAD * w->legs[leg].rotation;
     }
-    
-    int i_k_count = 0;
-    for (int i = 0; i < IK_ITERATIONS; i++) {
-        positions[JOINT_COUNT - 1] = t;
-        //Backwards
-        for (int i = JOINT_COUNT - 2; i >= 0; i--) {
-            Vector2 dir = Vector2Subtract(positions[i], positions[i + 1]);
-            dir = Vector2Normalize(dir);
-            positions[i] = Vector2Add(positions[i+1], Vector2Scale(dir, lengths[i]));
-        }
-        //forwards
-        positions[0] = fixed_start;
-        for (int i = 1; i < joint_count - 1; i++) {
-            Vector2 dir = Vector2Subtract(positions[i], positions[i - 1]);
-            dir = Vector2Normalize(dir);
-            positions[i] = Vector2Add(positions[i - 1], Vector2Scale(dir, lengths[i - 1]));
+    kernels.sincos(angle, sin_a, cos_a, JOINT_COUNT - 1);
+    for (int i = 0; i < JOINT_COUNT - 1; i++) {
+        dx[i] = dy[i] = 0.0f;
+        if (joints[i].connects_to == -1) continue;
+        Leg_Element* l = &w->legs[joints[i].connects_to];
+        Vector2 centre_fixed = joints[i].centre_position;
+        Vector2 pointA2 = (Vector2) {
+            .x = centre_fixed.x + (cos_a[i] * l->shape.width),
+            .y = centre_fixed.y + l->shape.height + (sin_a[i] * l->shape.width),
+        };
+        Vector2 pointB = joints[i + 1].centre_position;
+        dx[i] = pointB.x - pointA2.x;
+        dy[i] = pointB.y - pointA2.y;
+    }
+    kernels.atan2(dy, dx, aim, JOINT_COUNT - 1);
+    for (int i = 0; i < JOINT_COUNT - 1; i++) {
+        if (joints[i].connects_to == -1) continue;
+        Leg_Element* l = &w->legs[joints[i].connects_to];
+        float target = 180.0f + RAD2DEG * aim[i];
+        blend_set(&w->blend, BLEND_IK, joints[i].connects_to, target, blend_ik_segment_weight[i]);
+        l->shape.x = joints[i].centre_position.x;
+        l->shape.y = joints[i].centre_position.y;
+    }
+}
+
+// A single ball goes back to the middle of the screen; a drill is stacked in
+// rows upwards from there, one radius apart, so it rains onto the legs.
+void reset_balls(World* w)
+{
+    float x = WIDTH / 2, y = HEIGHT / 2;
+    for (int i = 0; i < w->ball_count; i++) {
+        Ball* b = &w->balls[i];
+        if (w->ball_count > 1) {
+            float spacing = 3.0f * b->radius;
+            int columns = (int)(WIDTH / spacing);
+            x = spacing * (0.5f + (float)(i % columns)) + (float)(i / columns % 2) * b->radius;
+            y = HEIGHT / 2 - spacing * (float)(i / columns);
         }
-        i_k_count++;
+        b->centre_position = (Vector2) {x, y};
+        b->velocity = (Vector2){0,0};
+        b->hit = false;
+    }
+    w->ball_contacts.count = 0;
+    w->leg_contacts.count = 0;
+    event_reset(w);
+}
+
+// Tops the world up to count small balls for multi-ball drills.
+void add_ball_drill(World* w, int count)
+{
+    if (count <= 1) return;
+    for (int i = 0; i < w->ball_count; i++) w->balls[i].radius = DRILL_BALL_RADIUS;
+    while (w->ball_count < count && add_ball(w, (Vector2) {0}) != -1) {
+        w->balls[w->ball_count - 1].radius = DRILL_BALL_RADIUS;
     }
+    reset_balls(w);
+}
 
-    for (int i = 0; i < JOINT_COUNT; i++) {
-        joints[i]->centre_position = positions[i];
+// True when stepping the world would change nothing on screen: no leg is
+// selected, no clip plays or is being captured, no IK or manual pose is still
+// fading out, no ball is in event driven flight and every ball is slower than
+// IDLE_REST_SPEED, as a ball resting on a leg or the floor is.
+bool world_quiescent(const World* w)
+{
+    if (w->selected_joint != -1 || w->anim.active_count > 0 || w->anim.capture->character >= 0) return false;
+    if (w->events.airborne_count > 0) return false;
+    const float* wi = w->blend.weight[BLEND_IK];
+    const float* wm = w->blend.weight[BLEND_MANUAL];
+    for (int i = 0; i < w->leg_count; i++) {
+        if (wi[i] > 0.0f || wm[i] > 0.0f) return false;
     }
+    for (int i = 0; i < w->ball_count; i++) {
+        if (Vector2LengthSqr(w->balls[i].velocity) > IDLE_REST_SPEED * IDLE_REST_SPEED) return false;
+    }
+    return true;
+}
 
+void draw_world(World* w)
+{
+    for (int i = 0; i < w->leg_count; i++) {
+        Leg_Element* l = &w->legs[i];
+        DrawRectanglePro(l->shape, get_leg_origin(l), l->rotation, w->leg_render[i].color);
+    }
+    for (int i = 0; i < w->joint_count; i++) {
+        DrawCircleV(w->joints[i].centre_position, w->joints[i].radius, GREEN);
+    }
+    for (int i = 0; i < w->pick.box_selection_count; i++) {
+        Joint_Element* j = &w->joints[w->pick.box_selection[i]];
+        DrawCircleV(j->centre_position, j->radius * 0.5f, YELLOW);
+    }
+    if (w->hovered_joint != -1) {
+        Joint_Element* j = &w->joints[w->hovered_joint];
+        DrawCircleLinesV(j->centre_position, j->radius + 2, WHITE);
+    }
+    for (int i = 0; i < w->leg_count; i++) {
+        draw_leg_points(&w->leg_points[i]);
+        // DrawCircleV((Vector2){w->legs[i].shape.x, w->legs[i].shape.y}, 4, YELLOW); // leg origin
+        // DrawCircleV(w->joints[w->legs[i].origin].centre_position, 4, ORANGE); // joint it connects to
+    }
+    for (int i = 0; i < w->ball_count; i++) {
+        DrawCircleV(w->balls[i].centre_position, w->balls[i].radius, LIGHTGRAY);
+    }
 }
 
-Vector2 get_rotated_end(Leg_Element l)
+// Dots along the predicted path and a ring where it ends in a contact.
+void draw_trajectory(const Trajectory* t)
 {
-    float dx = -l.shape.width;
-    float dy = l.shape.height;
-    float angle = DEG2RAD * l.rotation;
-    float rx = dx * cosf(angle) - dy * sinf(angle);
-    float ry = dx * sinf(angle) + dy * cosf(angle);
-    return (Vector2) {rx, ry};
+    if (t == NULL) return;
+    for (int i = 1; i < t->count; i++) DrawCircleV(t->points[i], 2, WHITE);
+    if (t->end != TRAJECTORY_HORIZON) DrawCircleLinesV(t->points[t->count - 1], 6, t->end == TRAJECTORY_LEG ? YELLOW : WHITE);
 }
 
-void update_joint_positions(Joint_Element** joints)
+// Runs the simulation stages without a window. Every foot is held on an IK
+// target that sweeps an ellipse in front of its hip (or, with animate, every
+// character plays the newest clip, the authored kick unless --clip added
+// one), and the balls are dropped again every two seconds, so every stage
+// runs every frame. With events, balls in free flight are moved by the event
+// queue instead of the stepped solver.
+void run_headless(World* w, const Headless_Options* opt)
 {
-    for (int i = 0; i < JOINT_COUNT; i++) 
-    {
-        if (i == 0) continue;
-        Leg_Element* parent = joints[i]->connects_from;
-        Leg_Element* l = parent;
-        float angle = DEG2RAD * l->rotation;
-        l->leg_points.top_right = (Vector2) {l->shape.x, l->shape.y};
-        Vector2 tr = l->leg_points.top_right;
-        l->leg_points.top_left = (Vector2) {
-            .x = tr.x + -l->shape.width * cosf(angle) - 0 * sinf(angle),
-            .y = tr.y + -l->shape.width * sinf(angle) + 0 * cosf(angle)
-        };
-        l->leg_points.bot_left = (Vector2) {
-            .x = tr.x + -l->shape.width * cosf(angle) - l->shape.height * sinf(angle),
-            .y = tr.y + -l->shape.width * sinf(angle) + l->shape.height * cosf(angle)
-        };
-        l->leg_points.bot_right = (Vector2) {
-            .x = tr.x + 0 * cosf(angle) - l->shape.height * sinf(angle),
-            .y = tr.y + 0 * sinf(angle) + l->shape.height * cosf(angle)
-        };
+    const float dt = 1.0f / 60.0f;
+    w->events.enabled = opt->events;
 
-        Vector2 rotated = get_rotated_end(*parent);
+    if (opt->animate) {
+        for (int c = 0; c < w->character_count; c++) {
+            anim_play(w, c, w->anim.clip_count - 1, 0.8f + 0.4f * (float)(c % 7) / 6.0f);
+        }
+    }
 
-        joints[i]->centre_position.x = parent->shape.x + rotated.x;
-        joints[i]->centre_position.y = parent->shape.y + rotated.y;
-        Leg_Element* ll = joints[i]->connects_to;
-        if (ll != NULL) {
-            ll->shape.x = joints[i]->centre_position.x;
-            ll->shape.y = joints[i]->centre_position.y;
+    for (int f = 0; f < opt->frames; f++) {
+        PROF_BEGIN(PROF_FRAME);
+        arena_reset(w->scratch);
+        // A lone ball is dropped again and again; a drill is left to settle.
+        if (w->ball_count == 1 && f % HEADLESS_BALL_RESET_FRAMES == 0) {
+            reset_balls(w);
         }
+        PROF_BEGIN(PROF_REORDER_BALLS);
+        reorder_balls(w);
+        PROF_END();
+        uint64_t managed_start = platform_now_ns();
+        lod_assign(w);
+        xpbd_begin_frame(&w->xpbd);
+        PROF_BEGIN(PROF_EVENTS);
+        event_begin_frame(w, dt);
+        PROF_END();
+
+        float t = (float)f * dt;
+        if (opt->animate) {
+            PROF_BEGIN(PROF_ANIM_SAMPLE);
+            anim_sample(w, dt);
+            PROF_END();
+        } else {
+            for (int c = 0; c < w->character_count; c++) {
+                int iterations = lod_ik_iterations[w->lod.tier[c]];
+                if (iterations == 0 || !lod_due(&w->lod, c)) continue;
+                Vector2 hip = w->joints[w->characters[c].first_joint].centre_position;
+                Vector2 target = {
+                    .x = hip.x - 200.0f + 120.0f * cosf(t * 3.0f + c),
+                    .y = hip.y + 150.0f + 90.0f * sinf(t * 3.0f + c)
+                };
+                xpbd_drive(w, c, target, iterations);
+            }
+        }
+        PROF_BEGIN(PROF_XPBD_STEP);
+        xpbd_step(w, dt, 1.0f);
+        PROF_END();
+
+        PROF_BEGIN(PROF_HANDLE_LEG_ELEMENTS);
+        handle_leg_elements(w, 0.0f);
+        PROF_END();
+        PROF_BEGIN(PROF_BLEND_POSES);
+        blend_poses(w, dt);
+        PROF_END();
+        PROF_BEGIN(PROF_UPDATE_JOINT_POSITIONS);
+        update_joint_positions(w);
+        PROF_END();
+        PROF_BEGIN(PROF_EVENTS);
+        event_end_frame(w, dt);
+        PROF_END();
+        lod_end_frame(&w->lod, platform_now_ns() - managed_start);
+        PROF_END();
+        PROF_FRAME_END();
+        telemetry_publish(w);
+    }
+    printf("lod: %d full, %d reduced, %d anim-only characters on the last frame, bias %d\n",
+        w->lod.tier_count[LOD_FULL], w->lod.tier_count[LOD_REDUCED], w->lod.tier_count[LOD_ANIM], w->lod.bias);
+    if (w->ball_count >= REORDER_MIN_BALLS) {
+        printf("reorder: %lld reorders, disorder %.2f at the last check\n", w->ball_order.reorders, w->ball_order.disorder);
+    }
+    if (opt->events) {
+        printf("events: %d of %d balls airborne on the last frame, %lld predictions, %lld wakes\n",
+            w->events.airborne_count, w->ball_count, w->events.predictions, w->events.wakes);
     }
 }
 
-void rotate_legs(Joint_Element** joints)
+// Drops count uniform balls in packed form onto a field of their own and
+// steps them for frames frames. No legs, no window.
+bool run_packed(int count, int frames)
 {
-    for (int i = 0; i < JOINT_COUNT - 1; i++) {
-        Leg_Element* l = joints[i]->connects_to;
-        if (l == NULL) continue;
-        float a = DEG2RAD * l->rotation;
-        Vector2 centre_fixed = joints[i]->centre_position;
-        Vector2 pointA2 = (Vector2) {
-            .x = centre_fixed.x + (cosf(a) * l->shape.width),
-            .y = centre_fixed.y + l->shape.height + (sinf(a) * l->shape.width),
-        };
-        Vector2 pointB = joints[i + 1]->centre_position;
-        Vector2 diff = Vector2Subtract(pointB, pointA2);
-        float angle = 180.0f + (RAD2DEG * atan2(diff.y, diff.x));
-        l->rotation = angle;
-        l->shape.x = joints[i]->centre_position.x;
-        l->shape.y = joints[i]->centre_position.y;
+    const float dt = 1.0f / 60.0f;
+    int cells_x, cells_y;
+    packed_field_for(count, DRILL_BALL_RADIUS, &cells_x, &cells_y);
+    Arena arena;
+    Packed_Balls p;
+    if (!arena_init(&arena, "packed", packed_memory_size(count, cells_x, cells_y))
+        || !packed_init(&p, &arena, count, cells_x, cells_y, DRILL_BALL_RADIUS)) {
+        arena_release(&arena);
+        return false;
     }
+    packed_fill(&p, count, 1);
+
+    uint64_t start = platform_now_ns();
+    for (int f = 0; f < frames; f++) {
+        PROF_BEGIN(PROF_FRAME);
+        PROF_BEGIN(PROF_PACKED_STEP);
+        packed_step(&p, dt);
+        PROF_END();
+        PROF_END();
+        PROF_FRAME_END();
+    }
+    double ns = (double)(platform_now_ns() - start);
+    size_t state = 2 * sizeof(uint16_t) + 2 * sizeof(int16_t);
+    printf("packed: %d balls on %dx%d cells, %zu bytes per ball (%zu as Ball), %.1f MB of ball state\n",
+        p.count, cells_x, cells_y, state, sizeof(Ball), (double)(state * (size_t)p.count) / (1 << 20));
+    printf("packed: %.3f ms per step, %.1f ns per ball, mean speed %.3f px/frame after %d frames\n",
+        ns * 1e-6 / frames, ns / frames / (p.count > 0 ? p.count : 1), packed_mean_speed(&p), frames);
+    arena_release(&arena);
+    return true;
 }
 
-void update_ball(Ball* b, Leg_Element** legs, float dt)
+// C starts recording the selected character's leg rotations; pressing it
+// again compresses the recording into a new clip.
+void toggle_capture(World* w)
 {
-    if (IsKeyPressed(KEY_SPACE)) {
-        b->centre_position = (Vector2) {WIDTH/2, HEIGHT/2};
-        b->velocity = (Vector2){0,0};
-        b->acceleration = (Vector2){0,0};
-        b->hit = false;
+    Anim_System* a = &w->anim;
+    if (a->capture->character >= 0) {
+        int clip = anim_capture_end(a);
+        if (clip >= 0) {
+            printf("anim: captured clip %d (%d keys)\n", clip, a->clips[clip].key_count);
+            if (anim_clip_save(&a->clips[clip], ANIM_CAPTURE_FILE)) printf("anim: saved it to %s\n", ANIM_CAPTURE_FILE);
+            else printf("anim: could not write %s\n", ANIM_CAPTURE_FILE);
+        } else printf("anim: capture too short or too detailed to store\n");
+    } else if (w->selected_joint != -1) {
+        anim_capture_begin(a, joint_character(w, w->selected_joint));
     }
-    Vector2 ball_pos = b->centre_position;
-    Vector2 vel = b->velocity;
-    Vector2 acc = b->acceleration;
+}
+
+// Adds a clip saved by a capture to the world; P and --anim then play it.
+bool load_clip(World* w, const char* path)
+{
+    Anim_Clip clip;
+    if (!anim_clip_load(&clip, path)) {
+        printf("anim: %s is not a version %d clip\n", path, ANIM_VERSION);
+        return false;
+    }
+    if (anim_add_clip(&w->anim, &clip) == -1) {
+        printf("anim: no room for clip %s\n", path);
+        return false;
+    }
+    return true;
+}
 
-    if (!ball.hit) {
-        acc.y = GRAVITY * dt;
+// P plays the newest clip on every character, or stops all playback.
+void toggle_crowd_playback(World* w)
+{
+    Anim_System* a = &w->anim;
+    if (a->active_count > 0) {
+        for (int c = 0; c < w->character_count; c++) anim_stop(w, c);
+        return;
+    }
+    for (int c = 0; c < w->character_count; c++) {
+        anim_play(w, c, a->clip_count - 1, 1.0f);
     }
+}
 
-    //to-do: figure out velocity and acceleration relationship. I want the ball to stop if acc is 0
+void print_kick_result(const Kick_Result* r)
+{
+    printf("optimize: best distance to goal %.1f px after %d generations, %lld rollouts in %.3f s "
+        "(%.0f rollouts/s on %d threads)\n", r->best.cost, r->generations, r->rollouts, r->seconds,
+        r->seconds > 0.0 ? (double)r->rollouts / r->seconds : 0.0, r->threads);
+}
 
-    for (int i = 0; i < LEG_COUNT; i++) {
-        Leg_Points lp = legs[i]->leg_points;
-        bool top_hit = CheckCollisionCircleLine(ball_pos, BALL_RADIUS, lp.top_left, lp.top_right);
-        bool left_hit = CheckCollisionCircleLine(ball_pos, BALL_RADIUS, lp.top_left, lp.bot_left);
-        bool bot_hit = CheckCollisionCircleLine(ball_pos, BALL_RADIUS, lp.bot_left, lp.bot_right);
-        bool right_hit = CheckCollisionCircleLine(ball_pos, BALL_RADIUS, lp.top_right, lp.bot_right);
-
-        if (top_hit || left_hit || bot_hit || right_hit) {
-            printf("Hit! "); 
-            ball.hit = true;
-            vel.y = 0;
-            acc.y = 0;
-            break;
-        }
+// Loads the world either from a binary scene file, mapped in place, or by
+// building the default crowd in the level arena.
+bool load_world(World* w, Arena* level, Arena* scratch, Platform_Mapping* scene, const char* scene_path, int character_count)
+{
+    if (scene_path == NULL) return load_level(w, level, scratch, character_count);
+
+    uint64_t start = platform_now_ns();
+    platform_unmap_file(scene);
+    if (!scene_map(w, scene, scratch, scene_path)) return false;
+    if (w->max_balls > CONTACT_MAX_BALLS) {
+        printf("scene: %s holds %d balls, contact keys allow %d\n", scene_path, w->max_balls, CONTACT_MAX_BALLS);
+        return false;
     }
-    printf("Vel: %f %f, Acc: %f %f\n",vel.x, vel.y, acc.x, acc.y);
-    vel = Vector2Add(vel, acc);
 
-    ball_pos.x += b->velocity.x;
-    ball_pos.y += b->velocity.y;
+    // The mapped file only carries the simulation arrays; the runtime state
+    // lives in the level arena, which grows here if the scene needs more.
+    size_t runtime_size = world_runtime_memory_size(w->character_count, w->max_balls);
+    if (level->capacity < runtime_size) {
+        arena_release(level);
+        if (!arena_init(level, "level", runtime_size)) return false;
+    }
+    arena_reset(level);
+    if (!world_init_runtime(w, level, w->character_count)) return false;
+    pick_rebuild(&w->pick, w);
+    printf("scene: mapped %d characters from %s in %.3f ms\n", w->character_count, scene_path,
+        (double)(platform_now_ns() - start) * 1e-6);
+    return true;
+}
 
-    b->centre_position.x = ball_pos.x;
-    b->centre_position.y = ball_pos.y;
-    b->velocity = vel;
-    b->acceleration = acc;
+// Tears down what main set up once the world was loaded, whichever mode ran.
+static void shutdown_world(Platform_Mapping* scene, Arena* level_arena, Arena* frame_arena, bool window)
+{
+    telemetry_close();
+    PROF_SHUTDOWN();
+#ifdef ARENA_DEBUG
+    arena_report(level_arena, stdout);
+    arena_report(frame_arena, stdout);
+#endif
+    platform_unmap_file(scene);
+    arena_release(frame_arena);
+    arena_release(level_arena);
+    if (window) CloseWindow();
 }
 
+// Every key the window loop or the profiler overlay acts on.
+static const int app_keys[] = {KEY_R, KEY_C, KEY_P, KEY_SPACE, KEY_O, PROF_KEY_OVERLAY, PROF_KEY_DUMP};
+
+// Whether anything reached raylib since the last frame: keys, buttons, the
+// wheel, or cursor motion, including motion only the input ring recorded.
+// Only reads state, so calling it again after EndDrawing takes nothing away
+// from the next frame; GetKeyPressed would pop raylib's key queue.
+static bool frame_has_input(uint32_t* cursor_head)
+{
+    bool moved = input_ring.head != *cursor_head;
+    *cursor_head = input_ring.head;
+    Vector2 delta = GetMouseDelta();
+    bool key = false;
+    for (int i = 0; i < (int)(sizeof(app_keys) / sizeof(app_keys[0])); i++) {
+        if (IsKeyPressed(app_keys[i])) key = true;
+    }
+    return moved || key || delta.x != 0.0f || delta.y != 0.0f || GetMouseWheelMove() != 0.0f
+        || IsMouseButtonDown(MOUSE_BUTTON_LEFT) || IsMouseButtonDown(MOUSE_BUTTON_RIGHT)
+        || IsMouseButtonReleased(MOUSE_BUTTON_LEFT) || IsMouseButtonReleased(MOUSE_BUTTON_RIGHT);
+}
 
 int main (int argc, char* argv[])
 {
-    (void)argc; (void)argv;
+    Headless_Options headless = {0};
+    int character_count = 1;
+    const char* scene_path = NULL;
+    const char* clip_path = NULL;
+    bool optimize = false;
+    int ball_count = 1;
+    int packed_count = 0;
+    bool counters = false;
+    bool live = false;
+    Vector2 goal = {0};
+    double budget_ms = KICK_DEFAULT_BUDGET_MS;
+    bool self_test = false;
+    Cpu_Level cpu_level = CPU_LEVEL_COUNT - 1;
+    dispatch_init(cpu_level);
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--convert") == 0 && i + 2 < argc) {
+            return scene_convert(argv[i + 1], argv[i + 2]) ? 0 : 1;
+        } else if (strcmp(argv[i], "--cpu") == 0 && i + 1 < argc) {
+            if (!cpu_level_parse(argv[++i], &cpu_level)) printf("unknown --cpu level %s\n", argv[i]);
+        } else if (strcmp(argv[i], "--self-test") == 0) {
+            self_test = true;
+        } else if (strcmp(argv[i], "--scene") == 0 && i + 1 < argc) {
+            scene_path = argv[++i];
+        } else if (strcmp(argv[i], "--clip") == 0 && i + 1 < argc) {
+            clip_path = argv[++i];
+        } else if (strcmp(argv[i], "--headless") == 0) {
+            headless.frames = (i + 1 < argc) ? atoi(argv[++i]) : HEADLESS_DEFAULT_FRAMES;
+            if (headless.frames <= 0) headless.frames = HEADLESS_DEFAULT_FRAMES;
+        } else if (strcmp(argv[i], "--counters") == 0) {
+            counters = true;
+        } else if (strcmp(argv[i], "--telemetry") == 0) {
+            live = true;
+        } else if (strcmp(argv[i], "--anim") == 0) {
+            headless.animate = true;
+        } else if (strcmp(argv[i], "--events") == 0) {
+            headless.events = true;
+        } else if (strcmp(argv[i], "--optimize") == 0) {
+            if (i + 2 >= argc) {
+                printf("usage: --optimize <goal x> <goal y> [budget ms]\n");
+                return 1;
+            }
+            optimize = true;
+            goal.x = (float)atof(argv[i + 1]);
+            goal.y = (float)atof(argv[i + 2]);
+            i += 2;
+            if (i + 1 < argc && argv[i + 1][0] != '-') budget_ms = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--packed") == 0 && i + 1 < argc) {
+            packed_count = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--balls") == 0 && i + 1 < argc) {
+            ball_count = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--characters") == 0 && i + 1 < argc) {
+            character_count = atoi(argv[++i]);
+            if (character_count < 1) character_count = 1;
+            if (character_count > MAX_CHARACTERS) character_count = MAX_CHARACTERS;
+        }
+    }
 
-    InitWindow(WIDTH, HEIGHT, "maradonna");
+    // --cpu applies wherever it appears, so the self-test runs after it.
+    dispatch_init(cpu_level);
+    if (self_test) {
+        bool ok = dispatch_self_test();
+        ok = fastmath_self_test() && ok;
+        return anim_self_test() && ok ? 0 : 1;
+    }
 
-    hip = make_joint_element(NULL, &thigh, JOINT_RADIUS);
-    hip.centre_position = (Vector2) {WIDTH, 500};
-    thigh = make_leg_element(&hip, 120.0f, 50.0f);
-    knee = make_joint_element(&thigh, &leg, JOINT_RADIUS);
-    leg = make_leg_element(&knee, 50.0f, 160.0f);
-    ankle = make_joint_element(&leg, &foot, JOINT_RADIUS);
-    foot = make_leg_element(&ankle, 75.0f, 30.0f);
-    toe = make_joint_element(&foot, NULL, JOINT_RADIUS);
-    ball = (Ball) {
-        .centre_position = (Vector2){WIDTH * 0.5f, HEIGHT * 0.5f},
-        .velocity = (Vector2){0,0},
-        .acceleration = (Vector2){0,0},
-        .radius = BALL_RADIUS,
-        .hit = false
-    };
+    if (packed_count > 0) {
+        PROF_INIT();
+        if (counters) PROF_ENABLE_COUNTERS();
+        bool ok = run_packed(packed_count, headless.frames > 0 ? headless.frames : PACKED_DEFAULT_FRAMES);
+        if (!ok) printf("packed: could not allocate %d balls\n", packed_count);
+        PROF_SHUTDOWN();
+        return ok ? 0 : 1;
+    }
 
-    SetTargetFPS(60);
-    selected_joint = -1;
-
-    joints_array[0] = &hip;
-    joints_array[1] = &knee;
-    joints_array[2] = &ankle;
-    joints_array[3] = &toe;
-   
-    legs_array[0] = &thigh;
-    legs_array[1] = &leg;
-    legs_array[2] = &foot;
-    update_joint_positions(joints_array);
+    if (headless.frames == 0 && !optimize) InitWindow(WIDTH, HEIGHT, "maradonna");
+
+    Arena level_arena;
+    Arena frame_arena;
+    Platform_Mapping scene = {0};
+    World world;
+    World* w = &world;
+    if (!arena_init(&level_arena, "level", world_memory_size(character_count, MAX_BALLS))
+        || !arena_init(&frame_arena, "frame", FRAME_ARENA_SIZE)
+        || !load_world(w, &level_arena, &frame_arena, &scene, scene_path, character_count)) {
+        printf("could not load a world with %d characters\n", character_count);
+        return 1;
+    }
+    add_ball_drill(w, ball_count);
+    if (clip_path != NULL && !load_clip(w, clip_path)) return 1;
+
+    PROF_INIT();
+    if (counters) PROF_ENABLE_COUNTERS();
+
+    if (optimize) {
+        Kick_Result r;
+        bool ok = optimize_kick(w, 0, goal, budget_ms * 1e-3, &r);
+        if (ok) print_kick_result(&r);
+        else printf("optimize: could not allocate rollout worlds\n");
+        shutdown_world(&scene, &level_arena, &frame_arena, false);
+        return ok ? 0 : 1;
+    }
+
+    if (live) telemetry_open();
+    if (headless.frames > 0) {
+#ifndef PROFILER_ENABLED
+        printf("headless: built with PROFILE=0, no timings will be reported\n");
+#endif
+        run_headless(w, &headless);
+        shutdown_world(&scene, &level_arena, &frame_arena, false);
+        return 0;
+    }
     
+    // With sub-frame input we pace frames ourselves, blocking on input events
+    // between them, instead of letting EndDrawing sleep through them.
+    bool sub_frame_input = input_init();
+    SetTargetFPS(sub_frame_input ? 0 : 60);
+    uint64_t sim_time = platform_now_ns();
+    uint64_t next_frame = sim_time;
+
+    // O searches for a kick of the selected character towards the cursor and
+    // then plays the best plan back as IK targets.
+    Kick_Plan kick = {0};
+    Vector2 kick_hip = {0};
+    int kick_character = -1;
+    int kick_frame = 0;
+
+    // Once nothing has moved for a while and a frame passes without input,
+    // the loop stops stepping and drawing and sleeps until the next event.
+    int settled_frames = 0;
+    uint32_t cursor_head = input_ring.head;
+
     while (!WindowShouldClose())
     {
-        float dt = GetFrameTime();
-        select_joint(joints_array);
-
-        if (IsMouseButtonDown(MOUSE_LEFT_BUTTON) && foot.selected) {
-            Vector2 mouse = GetMousePosition();
-            solve_leg_chain(mouse, joints_array, JOINT_COUNT);
-            rotate_legs(joints_array);
+        PROF_BEGIN(PROF_FRAME);
+        arena_reset(&frame_arena);
+        bool input = frame_has_input(&cursor_head);
+        // raylib counts a sleep into the frame time of the frame after the
+        // one it woke, so a step never covers more than MAX_FRAME_DT.
+        float dt = fminf(GetFrameTime(), MAX_FRAME_DT);
+        PROF_HANDLE_KEYS();
+        if (IsKeyPressed(KEY_R)) {
+            if (!load_world(w, &level_arena, &frame_arena, &scene, scene_path, character_count)) break;
+            add_ball_drill(w, ball_count);
+            if (clip_path != NULL) load_clip(w, clip_path);
         }
 
-        update_joint_positions(joints_array);
-        handle_leg_elements(legs_array);
+        PROF_BEGIN(PROF_SELECT_JOINT);
+        select_joint(w);
+        PROF_END();
+        PROF_BEGIN(PROF_REORDER_BALLS);
+        reorder_balls(w);
+        PROF_END();
+
+        // Physics substeps walk the cursor path recorded since the last frame,
+        // so a fast flick reaches the IK target and leg rotation as a
+        // sequence of small moves instead of one jump.
+        if (IsKeyPressed(KEY_C)) toggle_capture(w);
+        if (IsKeyPressed(KEY_P)) toggle_crowd_playback(w);
+        if (IsKeyPressed(KEY_SPACE)) reset_balls(w);
+        if (IsKeyPressed(KEY_O)) {
+            int c = w->selected_joint != -1 ? joint_character(w, w->selected_joint) : 0;
+            Kick_Result r;
+            if (optimize_kick(w, c, GetMousePosition(), KICK_WINDOW_BUDGET_MS * 1e-3, &r)) {
+                print_kick_result(&r);
+                kick = r.best;
+                kick_character = c;
+                kick_frame = 0;
+                kick_hip = w->joints[w->characters[c].first_joint].centre_position;
+            }
+        }
+        uint64_t managed_start = platform_now_ns();
+        lod_assign(w);
+        xpbd_begin_frame(&w->xpbd);
+        PROF_BEGIN(PROF_ANIM_SAMPLE);
+        anim_sample(w, dt);
+        PROF_END();
+
+        uint64_t frame_time = platform_now_ns();
+        int sel = w->selected_joint;
+        bool dragging = IsMouseButtonDown(MOUSE_LEFT_BUTTON) && sel != -1 && w->joints[sel].connects_to == -1;
+        Vector2 mouse = GetMousePosition();
+        input_position_at(sim_time, &mouse.x, &mouse.y);
+        for (int k = 1; k <= PHYSICS_SUBSTEPS; k++) {
+            uint64_t t = sim_time + (frame_time - sim_time) * k / PHYSICS_SUBSTEPS;
+            Vector2 prev_mouse = mouse;
+            input_position_at(t, &mouse.x, &mouse.y);
+
+            if (dragging) {
+                xpbd_drive(w, joint_character(w, sel), mouse, IK_ITERATIONS);
+            } else if (kick_character != -1) {
+                Vector2 target = kick_plan_target(&kick, kick_hip, (float)kick_frame + (float)k / PHYSICS_SUBSTEPS);
+                xpbd_drive(w, kick_character, target, IK_ITERATIONS);
+            }
+            PROF_BEGIN(PROF_XPBD_STEP);
+            xpbd_step(w, dt, 1.0f / PHYSICS_SUBSTEPS);
+            PROF_END();
+
+            PROF_BEGIN(PROF_HANDLE_LEG_ELEMENTS);
+            handle_leg_elements(w, mouse.y - prev_mouse.y);
+            PROF_END();
+            PROF_BEGIN(PROF_BLEND_POSES);
+            blend_poses(w, dt / PHYSICS_SUBSTEPS);
+            PROF_END();
+            PROF_BEGIN(PROF_UPDATE_JOINT_POSITIONS);
+            update_joint_positions(w);
+            PROF_END();
+        }
+        sim_time = frame_time;
+        lod_end_frame(&w->lod, platform_now_ns() - managed_start);
+        if (kick_character != -1 && ++kick_frame >= KICK_HORIZON) kick_character = -1;
+        anim_capture_frame(&w->anim, w);
 
-        update_ball(&ball, legs_array, dt);
+        PROF_BEGIN(PROF_UPDATE_PICKING);
+        update_picking(w);
+        PROF_END();
 
+        PROF_BEGIN(PROF_DRAW);
         BeginDrawing();
             ClearBackground(P_DARK_BLUE);
-            DrawRectanglePro(thigh.shape, get_leg_origin(&thigh), thigh.rotation, thigh.color);
-            DrawRectanglePro(leg.shape, get_leg_origin(&leg), leg.rotation, leg.color);
-            DrawRectanglePro(foot.shape, get_leg_origin(&foot), foot.rotation, foot.color);
-            DrawCircleV(hip.centre_position, hip.radius, GREEN);
-            DrawCircleV(knee.centre_position, knee.radius, GREEN);
-            DrawCircleV(ankle.centre_position, ankle.radius, GREEN);
-            DrawCircleV(toe.centre_position, toe.radius, GREEN);
-            for (int i = 0; i < 3; i++) {
-                draw_leg_points(legs_array[i]);
-                // DrawCircleV((Vector2){legs_array[i]->shape.x, legs_array[i]->shape.y}, 4, YELLOW); // leg origin
-                // DrawCircleV(legs_array[i]->origin->centre_position, 4, ORANGE); // joint it connects to
-            }
-            DrawCircleV(ball.centre_position, ball.radius, LIGHTGRAY);
-            // DrawLine(hip.centre_position.x, hip.centre_position.y, knee.centre_position.x, knee.centre_position.y, BLACK);
-            // DrawLine(knee.centre_position.x, knee.centre_position.y, ankle.centre_position.x, ankle.centre_position.y, BLACK);
-            // DrawLine(ankle.centre_position.x, ankle.centre_position.y, toe.centre_position.x, toe.centre_position.y, BLACK);
+            draw_world(w);
+            // While aiming or playing a kick, show where the ball is headed.
+            if (w->selected_joint != -1 || kick_character != -1) draw_trajectory(trajectory_predict(w, 0));
+            PROF_DRAW_OVERLAY(10, 10);
+        PROF_END();
+        PROF_BEGIN(PROF_PRESENT);
         EndDrawing();
+        settled_frames = world_quiescent(w) && kick_character == -1 ? settled_frames + 1 : 0;
+        // EndDrawing polled events; anything that arrived during this frame
+        // is already queued in raylib and would not wake the wait below.
+        bool sleep = settled_frames >= IDLE_SETTLE_FRAMES && !input && !frame_has_input(&cursor_head);
+        if (sub_frame_input && !sleep) {
+            next_frame += FRAME_NS;
+            if (next_frame < platform_now_ns()) next_frame = platform_now_ns();
+            input_wait_until(next_frame);
+        }
+        PROF_END();
+        PROF_END();
+        PROF_FRAME_END();
+        telemetry_publish(w);
+
+        // The frame an event wakes runs at once rather than on the old
+        // schedule, and its substeps start from the wake-up, not the sleep.
+        if (sleep) {
+            input_wait_event();
+            next_frame = platform_now_ns();
+            sim_time = next_frame;
+        }
     }
 
-    CloseWindow();
+    shutdown_world(&scene, &level_arena, &frame_arena, true);
 }
 
-void draw_leg_points(Leg_Element* l)
+void draw_leg_points(Leg_Points* lp)
 {
-    DrawCircleV(l->leg_points.top_left, 4, BLACK);
-    DrawCircleV(l->leg_points.top_right, 4, BLACK);
-    DrawCircleV(l->leg_points.bot_left, 4, BLACK);
-    DrawCircleV(l->leg_points.bot_right, 4, BLACK);
+    DrawCircleV(lp->top_left, 4, BLACK);
+    DrawCircleV(lp->top_right, 4, BLACK);
+    DrawCircleV(lp->bot_left, 4, BLACK);
+    DrawCircleV(lp->bot_right, 4, BLACK);
 }
\ No newline at end of file
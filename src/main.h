@@ -1,6 +1,23 @@
 #ifndef MAIN_H
 #define MAIN_H
 
+#include "arena.h"
+#include "platform.h"
+#include "pick.h"
+#include "anim.h"
+#include "blend.h"
+#include "lod.h"
+#include "xpbd.h"
+#include "bvh.h"
+#include "contact.h"
+#include "event.h"
+#include "trajectory.h"
+#include "reorder.h"
+#include "packed.h"
+#include "dispatch.h"
+#include "fastmath.h"
+#include "optimize.h"
+
 #define WIDTH 600
 #define HEIGHT 800
 
@@ -9,18 +26,40 @@
 #define LEG_COUNT 3
 #define IK_ITERATIONS 128
 
+#define MAX_CHARACTERS 100000
+#define MAX_BALLS 4096
+#define FRAME_ARENA_SIZE (16 << 20)
+#define CROWD_COLUMNS 16
+#define CROWD_SPACING 40
+
 #define BALL_RADIUS 30
+#define DRILL_BALL_RADIUS 6
 #define GRAVITY 10
 
-#define P_DARK_BLUE (Color) {0xa3, 0xb2, 0xd2, 0xff}
+#define FRAME_NS (1000000000ull / 60)
+#define MAX_FRAME_DT (4.0f / 60.0f)
+
+// The window loop sleeps on input events once the world has been quiescent
+// for IDLE_SETTLE_FRAMES frames in a row and a frame passed without input.
+#define IDLE_REST_SPEED 0.5f
+#define IDLE_SETTLE_FRAMES 30
 
-typedef struct leg Leg_Element;
+#define HEADLESS_DEFAULT_FRAMES 10000
+#define HEADLESS_BALL_RESET_FRAMES 120
+#define PACKED_DEFAULT_FRAMES 600
+#define TRANSFORM_BLOCK 64
+#define KICK_DEFAULT_BUDGET_MS 1000.0
+#define KICK_WINDOW_BUDGET_MS 200.0
 
+#define P_DARK_BLUE (Color) {0xa3, 0xb2, 0xd2, 0xff}
+
+// Joints, legs and balls live in flat arrays inside World and refer to each
+// other by index; -1 means "not connected".
 typedef struct joint {
     Vector2 centre_position;
     float radius;
-    Leg_Element *connects_from;
-    Leg_Element *connects_to;
+    int connects_from;
+    int connects_to;
 } Joint_Element;
 
 typedef struct leg_points {
@@ -30,37 +69,109 @@ typedef struct leg_points {
     Vector2 bot_right;
 } Leg_Points;
 
+// Hot per-leg record read by IK, the transform pass and collision: the pivot
+// (shape.x, shape.y), size, rotation in degrees and origin joint. Exactly one
+// half cache line, so two legs share a line and none straddles one.
 typedef struct leg {
     Rectangle shape;
-    Vector2 centre_pos;
-    Joint_Element *origin;
-    bool selected;
-    Color color;
     float rotation;
-    Leg_Points leg_points;
-} Leg_Element;
+    int origin;
+} __attribute__((aligned(32))) Leg_Element;
+
+_Static_assert(sizeof(Leg_Element) == 32, "Leg_Element must stay one 32-byte record");
+
+// Render and editor state, kept in an array parallel to World.legs.
+typedef struct leg_render {
+    Color color;
+    bool selected;
+} Leg_Render;
 
 typedef struct ball {
     Vector2 centre_position;
     Vector2 velocity;
-    Vector2 acceleration;
     float radius;
     bool hit;
 } Ball;
 
+typedef struct character {
+    int first_joint;
+    int first_leg;
+} Character;
+
+// All arrays, including the picking grid, are carved out of the level arena
+// by world_init and sized for max_characters / max_balls. scratch is the per-frame arena, reset at the top
+// of every frame. pose_version moves on whenever a leg collider moves, so
+// anything derived from the pose can tell when it is stale.
+typedef struct world {
+    Joint_Element* joints;
+    Leg_Element* legs;
+    Leg_Points* leg_points;
+    Leg_Render* leg_render;
+    Ball* balls;
+    Character* characters;
+    int joint_count;
+    int leg_count;
+    int ball_count;
+    int character_count;
+    int max_characters;
+    int max_balls;
+    int selected_joint;
+    int hovered_joint;
+    Pick_Grid pick;
+    Anim_System anim;
+    Blend_Layers blend;
+    Lod_System lod;
+    Xpbd_Solver xpbd;
+    Contact_Cache ball_contacts;
+    Leg_Manifold leg_contacts;
+    Bvh_Tree leg_tree;
+    Event_Queue events;
+    Trajectory_Cache trajectories;
+    Ball_Order ball_order;
+    uint32_t pose_version;
+    Arena* scratch;
+} World;
+
+typedef struct headless_options {
+    int frames;
+    bool animate;
+    bool events;
+} Headless_Options;
+
+
 
+extern const Vector2 default_leg_sizes[LEG_COUNT];
 
-Leg_Element make_leg_element(Joint_Element* origin, float width, float height);
+size_t world_memory_size(int max_characters, int max_balls);
+size_t world_runtime_memory_size(int max_characters, int max_balls);
+bool world_init_runtime(World* w, Arena* level, int max_characters);
+bool world_init(World* w, Arena* level, Arena* scratch, int max_characters, int max_balls);
+bool load_level(World* w, Arena* level, Arena* scratch, int character_count);
+Leg_Element make_leg_element(World* w, int origin, float width, float height);
 Vector2 get_leg_origin(Leg_Element* l);
-Joint_Element make_joint_element(Leg_Element* from, Leg_Element* to, float radius);
-void select_joint(Joint_Element** joints);
-void handle_leg_elements(Leg_Element** legs);
-void move_leg(Leg_Element* l);
-void update_joint_positions(Joint_Element** joints); 
-void solve_leg_chain(Vector2 target, Joint_Element** joints, int joint_count);
-void rotate_legs(Joint_Element** joints);
-void update_ball(Ball* b, Leg_Element** legs, float dt);
-void draw_leg_points(Leg_Element* l);
+Joint_Element make_joint_element(World* w, int from, int to, float radius);
+int add_character(World* w, Vector2 hip_position, const Vector2* sizes);
+int add_ball(World* w, Vector2 position);
+int joint_character(World* w, int joint);
+void select_joint(World* w);
+void update_picking(World* w);
+void handle_leg_elements(World* w, float mouse_dy);
+void move_leg(World* w, int leg, float mouse_dy);
+void update_joint_positions(World* w);
+void rotate_legs(World* w, int character);
+void reset_balls(World* w);
+bool world_quiescent(const World* w);
+void add_ball_drill(World* w, int count);
+void draw_world(World* w);
+void draw_leg_points(Leg_Points* lp);
+void draw_trajectory(const Trajectory* t);
+void run_headless(World* w, const Headless_Options* opt);
+bool run_packed(int count, int frames);
+void toggle_capture(World* w);
+bool load_clip(World* w, const char* path);
+void toggle_crowd_playback(World* w);
+void print_kick_result(const Kick_Result* r);
+bool load_world(World* w, Arena* level, Arena* scratch, Platform_Mapping* scene, const char* scene_path, int character_count);
 
 #endif
 
@@ -0,0 +1,24 @@
+#ifndef MORTON_H
+#define MORTON_H
+
+#include <stdint.h>
+
+// Z-order codes: the bits of two 16-bit cell coordinates interleaved, so
+// points close in space mostly end up close in code order.
+
+static inline uint32_t morton_spread(uint32_t v)
+{
+    v &= 0xffff;
+    v = (v | (v << 8)) & 0x00ff00ff;
+    v = (v | (v << 4)) & 0x0f0f0f0f;
+    v = (v | (v << 2)) & 0x33333333;
+    v = (v | (v << 1)) & 0x55555555;
+    return v;
+}
+
+static inline uint32_t morton_code(uint32_t x, uint32_t y)
+{
+    return morton_spread(x) | morton_spread(y) << 1;
+}
+
+#endif
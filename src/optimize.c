@@ -0,0 +1,212 @@
+#include "raylib.h"
+#include "raymath.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "main.h"
+#include "input.h"
+
+#define KICK_DIMENSIONS (KICK_CONTROL_POINTS * 2)
+#define ROLLOUT_SCRATCH_SIZE (64 << 10)
+
+typedef struct rollout_worker {
+    Arena level;
+    Arena scratch;
+    World world;
+    uint64_t rng;
+    int rollouts;
+} Rollout_Worker;
+
+typedef struct kick_search {
+    const World* source;
+    int character;
+    Vector2 goal;
+    int thread_count;
+    uint64_t deadline;
+    float mean[KICK_DIMENSIONS];
+    float std[KICK_DIMENSIONS];
+    Kick_Plan population[KICK_POPULATION];
+    Rollout_Worker workers[PLATFORM_MAX_THREADS];
+} Kick_Search;
+
+Vector2 kick_plan_target(const Kick_Plan* plan, Vector2 hip, float frame)
+{
+    float s = frame * (float)(KICK_CONTROL_POINTS - 1) / (float)(KICK_HORIZON - 1);
+    if (s < 0.0f) s = 0.0f;
+    if (s > (float)(KICK_CONTROL_POINTS - 1)) s = (float)(KICK_CONTROL_POINTS - 1);
+    int i = (int)s;
+    if (i >= KICK_CONTROL_POINTS - 1) i = KICK_CONTROL_POINTS - 2;
+    Vector2 p = Vector2Lerp(plan->points[i], plan->points[i + 1], s - (float)i);
+    return Vector2Add(hip, p);
+}
+
+static uint64_t rng_next(uint64_t* s)
+{
+    *s ^= *s << 13;
+    *s ^= *s >> 7;
+    *s ^= *s << 17;
+    return *s;
+}
+
+static float rng_gaussian(uint64_t* s)
+{
+    float u1 = ((float)(rng_next(s) >> 40) + 1.0f) / 16777217.0f;
+    float u2 = (float)(rng_next(s) >> 40) / 16777216.0f;
+    return sqrtf(-2.0f * logf(u1)) * cosf(2.0f * PI * u2);
+}
+
+// Copies one character and the first ball of src into dst as character 0.
+static void copy_character(World* dst, const World* src, int c)
+{
+    const Character* ch = &src->characters[c];
+    dst->character_count = 1;
+    dst->joint_count = JOINT_COUNT;
+    dst->leg_count = LEG_COUNT;
+    dst->ball_count = src->ball_count > 0 ? 1 : 0;
+    dst->characters[0] = (Character) {0};
+
+    for (int j = 0; j < JOINT_COUNT; j++) {
+        Joint_Element e = src->joints[ch->first_joint + j];
+        if (e.connects_from != -1) e.connects_from -= ch->first_leg;
+        if (e.connects_to != -1) e.connects_to -= ch->first_leg;
+        dst->joints[j] = e;
+    }
+    for (int l = 0; l < LEG_COUNT; l++) {
+        dst->legs[l] = src->legs[ch->first_leg + l];
+        dst->legs[l].origin -= ch->first_joint;
+        dst->leg_points[l] = src->leg_points[ch->first_leg + l];
+        dst->leg_render[l] = src->leg_render[ch->first_leg + l];
+        for (int s = 0; s < BLEND_SOURCE_COUNT; s++) {
+            dst->blend.rotation[s][l] = 0.0f;
+            dst->blend.weight[s][l] = 0.0f;
+        }
+    }
+    if (dst->ball_count > 0) dst->balls[0] = src->balls[0];
+    // Contacts and flights cached by the last rollout belong to another
+    // character and ball.
+    dst->ball_contacts.count = 0;
+    dst->leg_contacts.count = 0;
+    event_reset(dst);
+    bvh_rebuild(&dst->leg_tree, dst);
+}
+
+static float rollout(Rollout_Worker* wk, const Kick_Search* search, const Kick_Plan* plan)
+{
+    World* w = &wk->world;
+    const float dt = 1.0f / 60.0f;
+    copy_character(w, search->source, search->character);
+    if (w->ball_count == 0) return 0.0f;
+
+    Vector2 hip = w->joints[0].centre_position;
+    for (int f = 0; f < KICK_HORIZON; f++) {
+        for (int k = 1; k <= KICK_ROLLOUT_SUBSTEPS; k++) {
+            arena_reset(w->scratch);
+            Vector2 target = kick_plan_target(plan, hip, (float)f + (float)k / KICK_ROLLOUT_SUBSTEPS);
+            xpbd_drive(w, 0, target, KICK_ROLLOUT_ITERATIONS);
+            xpbd_step(w, dt, 1.0f / KICK_ROLLOUT_SUBSTEPS);
+            blend_poses(w, dt / KICK_ROLLOUT_SUBSTEPS);
+            update_joint_positions(w);
+        }
+    }
+    return Vector2Distance(w->balls[0].centre_position, search->goal);
+}
+
+static void rollout_thread(void* arg, int index)
+{
+    Kick_Search* search = arg;
+    Rollout_Worker* wk = &search->workers[index];
+    wk->rollouts = 0;
+    for (int i = index; i < KICK_POPULATION; i += search->thread_count) {
+        Kick_Plan* p = &search->population[i];
+        // Past the deadline the rest of the generation is left unscored.
+        if (platform_now_ns() >= search->deadline) {
+            p->cost = INFINITY;
+            continue;
+        }
+        for (int d = 0; d < KICK_DIMENSIONS; d++) {
+            float v = search->mean[d] + search->std[d] * rng_gaussian(&wk->rng);
+            if (d % 2 == 0) p->points[d / 2].x = v;
+            else p->points[d / 2].y = v;
+        }
+        p->cost = rollout(wk, search, p);
+        wk->rollouts++;
+    }
+}
+
+static int compare_cost(const void* a, const void* b)
+{
+    float ca = ((const Kick_Plan*)a)->cost;
+    float cb = ((const Kick_Plan*)b)->cost;
+    return (ca > cb) - (ca < cb);
+}
+
+bool optimize_kick(const World* w, int character, Vector2 goal, double budget_seconds, Kick_Result* out)
+{
+    uint64_t start = platform_now_ns();
+    Kick_Search* search = calloc(1, sizeof(Kick_Search));
+    if (search == NULL) return false;
+
+    search->source = w;
+    search->character = character;
+    search->goal = goal;
+    search->deadline = start + (uint64_t)(budget_seconds * 1e9);
+    search->thread_count = platform_cpu_count();
+    if (search->thread_count > PLATFORM_MAX_THREADS) search->thread_count = PLATFORM_MAX_THREADS;
+
+    bool ok = true;
+    int ready = 0;
+    for (; ready < search->thread_count && ok; ready++) {
+        Rollout_Worker* wk = &search->workers[ready];
+        ok = arena_init(&wk->level, "rollout", world_memory_size(1, 1))
+            && arena_init(&wk->scratch, "rollout scratch", ROLLOUT_SCRATCH_SIZE)
+            && world_init(&wk->world, &wk->level, &wk->scratch, 1, 1);
+        wk->rng = 0x9e3779b97f4a7c15ull * (uint64_t)(ready + 1);
+    }
+
+    // Start the search around the foot's current offset from the hip.
+    const Character* ch = &w->characters[character];
+    Vector2 hip = w->joints[ch->first_joint].centre_position;
+    Vector2 toe = w->joints[ch->first_joint + JOINT_COUNT - 1].centre_position;
+    for (int d = 0; d < KICK_DIMENSIONS; d++) {
+        search->mean[d] = (d % 2 == 0) ? toe.x - hip.x : toe.y - hip.y;
+        search->std[d] = KICK_INITIAL_STD;
+    }
+
+    Kick_Result r = {.best = {.cost = INFINITY}, .threads = search->thread_count};
+    int elites = (int)(KICK_POPULATION * KICK_ELITE_FRACTION);
+    while (ok) {
+        platform_run_parallel(search->thread_count, rollout_thread, search);
+        int scored = 0;
+        for (int i = 0; i < search->thread_count; i++) scored += search->workers[i].rollouts;
+        r.rollouts += scored;
+
+        qsort(search->population, KICK_POPULATION, sizeof(Kick_Plan), compare_cost);
+        if (scored > 0 && search->population[0].cost < r.best.cost) r.best = search->population[0];
+        if (scored < KICK_POPULATION) break;
+        r.generations++;
+
+        for (int d = 0; d < KICK_DIMENSIONS; d++) {
+            float sum = 0.0f, sum2 = 0.0f;
+            for (int e = 0; e < elites; e++) {
+                const Vector2* p = &search->population[e].points[d / 2];
+                float v = (d % 2 == 0) ? p->x : p->y;
+                sum += v;
+                sum2 += v * v;
+            }
+            float mean = sum / (float)elites;
+            float var = sum2 / (float)elites - mean * mean;
+            search->mean[d] = mean;
+            search->std[d] = fmaxf(KICK_MIN_STD, sqrtf(fmaxf(var, 0.0f)));
+        }
+    }
+    r.seconds = (double)(platform_now_ns() - start) * 1e-9;
+
+    for (int i = 0; i < ready; i++) {
+        arena_release(&search->workers[i].scratch);
+        arena_release(&search->workers[i].level);
+    }
+    free(search);
+    if (ok) *out = r;
+    return ok;
+}
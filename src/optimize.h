@@ -0,0 +1,47 @@
+#ifndef OPTIMIZE_H
+#define OPTIMIZE_H
+
+#include <stdbool.h>
+
+// Kick optimizer. A candidate is a foot IK target trajectory: KICK_CONTROL_POINTS
+// offsets from the hip, linearly interpolated over KICK_HORIZON frames. Each
+// candidate is scored by a headless rollout of one character and one ball
+// through the same stages as the game loop, and the score is how far the
+// ball ends up from the goal. Rollouts solve the IK at the LOD_REDUCED
+// iteration count over KICK_ROLLOUT_SUBSTEPS substeps, an order of
+// magnitude cheaper than a played frame, so the window's budget still
+// covers several generations on a single core. The search is the cross-entropy method: sample
+// a population from a diagonal Gaussian, refit the Gaussian to the best
+// KICK_ELITE_FRACTION, repeat until the wall-clock budget runs out (rollouts
+// still pending at the deadline are dropped, so the budget holds to within
+// one rollout). Rollouts of a generation are spread over all cores, each
+// worker owning a private one-character world.
+
+#define KICK_CONTROL_POINTS 5
+#define KICK_HORIZON 120
+#define KICK_POPULATION 128
+#define KICK_ELITE_FRACTION 0.1f
+#define KICK_INITIAL_STD 120.0f
+#define KICK_MIN_STD 2.0f
+#define KICK_ROLLOUT_ITERATIONS LOD_REDUCED_ITERATIONS
+#define KICK_ROLLOUT_SUBSTEPS 2
+
+typedef struct kick_plan {
+    Vector2 points[KICK_CONTROL_POINTS];
+    float cost;
+} Kick_Plan;
+
+typedef struct kick_result {
+    Kick_Plan best;
+    long long rollouts;
+    int generations;
+    int threads;
+    double seconds;
+} Kick_Result;
+
+struct world;
+
+Vector2 kick_plan_target(const Kick_Plan* plan, Vector2 hip, float frame);
+bool optimize_kick(const struct world* w, int character, Vector2 goal, double budget_seconds, Kick_Result* out);
+
+#endif
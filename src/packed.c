@@ -0,0 +1,260 @@
+#include "raylib.h"
+#include "raymath.h"
+#include <math.h>
+#include "main.h"
+#include "packed.h"
+
+// Field coordinates in position units: cell * CELL_UNITS + offset - OFFSET_BIAS.
+#define CELL_UNITS 32768
+#define OFFSET_BIAS 16384
+#define VELOCITY_TO_POSITION ((int32_t)(PACKED_POSITION_ONE / PACKED_VELOCITY_ONE))
+
+size_t packed_memory_size(int capacity, int cells_x, int cells_y)
+{
+    size_t cells = (size_t)cells_x * cells_y + 1;
+    return (size_t)capacity * 2 * (2 * sizeof(uint16_t) + 2 * sizeof(int16_t))
+        + (size_t)capacity * sizeof(int32_t) + 2 * cells * sizeof(int32_t) + 11 * 16;
+}
+
+bool packed_init(Packed_Balls* p, Arena* a, int capacity, int cells_x, int cells_y, float radius)
+{
+    int cells = cells_x * cells_y;
+    *p = (Packed_Balls) {.capacity = capacity, .cells_x = cells_x, .cells_y = cells_y, .radius = radius};
+    p->x = ARENA_PUSH_ARRAY(a, uint16_t, capacity);
+    p->y = ARENA_PUSH_ARRAY(a, uint16_t, capacity);
+    p->vx = ARENA_PUSH_ARRAY(a, int16_t, capacity);
+    p->vy = ARENA_PUSH_ARRAY(a, int16_t, capacity);
+    p->next_x = ARENA_PUSH_ARRAY(a, uint16_t, capacity);
+    p->next_y = ARENA_PUSH_ARRAY(a, uint16_t, capacity);
+    p->next_vx = ARENA_PUSH_ARRAY(a, int16_t, capacity);
+    p->next_vy = ARENA_PUSH_ARRAY(a, int16_t, capacity);
+    p->next_cell = ARENA_PUSH_ARRAY(a, int32_t, capacity);
+    p->cell_start = ARENA_PUSH_ARRAY(a, int32_t, cells + 1);
+    p->cell_fill = ARENA_PUSH_ARRAY(a, int32_t, cells + 1);
+    if (p->x == NULL || p->y == NULL || p->vx == NULL || p->vy == NULL || p->next_x == NULL
+        || p->next_y == NULL || p->next_vx == NULL || p->next_vy == NULL || p->next_cell == NULL
+        || p->cell_start == NULL || p->cell_fill == NULL) return false;
+    for (int c = 0; c <= cells; c++) p->cell_start[c] = 0;
+    return true;
+}
+
+// A square field in which count balls cover PACKED_FIELD_FILL of the area.
+void packed_field_for(int count, float radius, int* cells_x, int* cells_y)
+{
+    float side = sqrtf((float)count * PI * radius * radius / PACKED_FIELD_FILL);
+    int cells = (int)ceilf(side / PACKED_CELL_SIZE);
+    if (cells < 3) cells = 3;
+    *cells_x = *cells_y = cells;
+}
+
+static int16_t saturate16(int32_t v)
+{
+    return (int16_t)(v > 32767 ? 32767 : v < -32767 ? -32767 : v);
+}
+
+static uint16_t clamp_offset(int32_t v)
+{
+    return (uint16_t)(v > 65535 ? 65535 : v < 0 ? 0 : v);
+}
+
+// Stages ball i at field coordinates (ax, ay), both inside the field.
+static void stage(Packed_Balls* p, int i, int32_t ax, int32_t ay, int16_t vx, int16_t vy)
+{
+    int32_t cx = ax / CELL_UNITS, cy = ay / CELL_UNITS;
+    p->next_x[i] = (uint16_t)(ax - cx * CELL_UNITS + OFFSET_BIAS);
+    p->next_y[i] = (uint16_t)(ay - cy * CELL_UNITS + OFFSET_BIAS);
+    p->next_vx[i] = vx;
+    p->next_vy[i] = vy;
+    p->next_cell[i] = cy * p->cells_x + cx;
+}
+
+// Moves the balls staged in next_* into their cells' buckets, keeping their
+// order within a cell.
+static void rebucket(Packed_Balls* p)
+{
+    int cells = p->cells_x * p->cells_y;
+    for (int c = 0; c <= cells; c++) p->cell_fill[c] = 0;
+    for (int i = 0; i < p->count; i++) p->cell_fill[p->next_cell[i] + 1]++;
+    for (int c = 0; c < cells; c++) p->cell_fill[c + 1] += p->cell_fill[c];
+    for (int c = 0; c <= cells; c++) p->cell_start[c] = p->cell_fill[c];
+    for (int i = 0; i < p->count; i++) {
+        int k = p->cell_fill[p->next_cell[i]]++;
+        p->x[k] = p->next_x[i];
+        p->y[k] = p->next_y[i];
+        p->vx[k] = p->next_vx[i];
+        p->vy[k] = p->next_vy[i];
+    }
+}
+
+// Balls on a jittered lattice over the field, with small random velocities.
+void packed_fill(Packed_Balls* p, int count, uint32_t seed)
+{
+    if (count > p->capacity) count = p->capacity;
+    float width = p->cells_x * PACKED_CELL_SIZE, height = p->cells_y * PACKED_CELL_SIZE;
+    float spacing = sqrtf(width * height / (float)count);
+    int columns = (int)(width / spacing);
+    if (columns < 1) columns = 1;
+    float jitter = fmaxf(0.0f, 0.5f * spacing - p->radius);
+    uint32_t s = seed;
+    for (int i = 0; i < count; i++) {
+        float r[4];
+        for (int k = 0; k < 4; k++) {
+            s = s * 1664525u + 1013904223u;
+            r[k] = (float)(s >> 8) / 16777216.0f * 2.0f - 1.0f;
+        }
+        float fx = Clamp(spacing * (0.5f + (float)(i % columns)) + jitter * r[0], p->radius, width - p->radius);
+        float fy = Clamp(spacing * (0.5f + (float)(i / columns)) + jitter * r[1], p->radius, height - p->radius);
+        stage(p, i, (int32_t)(fx * PACKED_POSITION_ONE), (int32_t)(fy * PACKED_POSITION_ONE),
+            saturate16((int32_t)(2.0f * r[2] * PACKED_VELOCITY_ONE)),
+            saturate16((int32_t)(2.0f * r[3] * PACKED_VELOCITY_ONE)));
+    }
+    p->count = count;
+    rebucket(p);
+}
+
+// Resolves ball i in cell (cx, cy) against ball j in cell (cx + ox, cy + oy).
+// In a shock pass the lower ball of the pair takes less of the push the
+// more directly it sits under the upper one, down to none.
+static void collide(Packed_Balls* p, int i, int j, int ox, int oy, int32_t diameter, bool shock)
+{
+    int32_t dx = ox * CELL_UNITS + (int32_t)p->x[j] - (int32_t)p->x[i];
+    int32_t dy = oy * CELL_UNITS + (int32_t)p->y[j] - (int32_t)p->y[i];
+    if (dx >= diameter || dx <= -diameter || dy >= diameter || dy <= -diameter) return;
+    int64_t d2 = (int64_t)dx * dx + (int64_t)dy * dy;
+    if (d2 >= (int64_t)diameter * diameter) return;
+
+    float dist = sqrtf((float)d2);
+    float nx = 0.0f, ny = 1.0f;
+    if (dist > 0.5f) {
+        nx = (float)dx / dist;
+        ny = (float)dy / dist;
+    }
+    float wi = 0.5f, wj = 0.5f;
+    if (shock) {
+        wi = 0.5f + 0.5f * ny;
+        wj = 1.0f - wi;
+    }
+
+    float overlap = (float)diameter - dist;
+    p->x[i] = clamp_offset((int32_t)p->x[i] - (int32_t)lrintf(wi * overlap * nx));
+    p->y[i] = clamp_offset((int32_t)p->y[i] - (int32_t)lrintf(wi * overlap * ny));
+    p->x[j] = clamp_offset((int32_t)p->x[j] + (int32_t)lrintf(wj * overlap * nx));
+    p->y[j] = clamp_offset((int32_t)p->y[j] + (int32_t)lrintf(wj * overlap * ny));
+}
+
+// One pass over every pair. The shock pass runs from the floor up, so each
+// row rests on rows already settled.
+static void collide_cells(Packed_Balls* p, int32_t diameter, bool shock)
+{
+    // Half the neighbourhood: every pair of cells is visited once.
+    static const int offsets[4][2] = {{1, 0}, {-1, 1}, {0, 1}, {1, 1}};
+    for (int row = 0; row < p->cells_y; row++) {
+        int cy = shock ? p->cells_y - 1 - row : row;
+        for (int cx = 0; cx < p->cells_x; cx++) {
+            int c = cy * p->cells_x + cx;
+            int begin = p->cell_start[c], end = p->cell_start[c + 1];
+            for (int i = begin; i < end; i++) {
+                for (int j = i + 1; j < end; j++) collide(p, i, j, 0, 0, diameter, shock);
+            }
+            for (int k = 0; k < 4; k++) {
+                int nx = cx + offsets[k][0], ny = cy + offsets[k][1];
+                if (nx < 0 || nx >= p->cells_x || ny >= p->cells_y) continue;
+                int n = ny * p->cells_x + nx;
+                for (int i = begin; i < end; i++) {
+                    for (int j = p->cell_start[n]; j < p->cell_start[n + 1]; j++) {
+                        collide(p, i, j, offsets[k][0], offsets[k][1], diameter, shock);
+                    }
+                }
+            }
+        }
+    }
+}
+
+// Bounces a coordinate off [lo, hi], keeping restitution of its speed.
+static void bounce(int32_t* a, int16_t* v, int32_t lo, int32_t hi, float restitution)
+{
+    if (*a < lo) {
+        *a = lo;
+        if (*v < 0) *v = saturate16((int32_t)(-restitution * (float)*v));
+    } else if (*a > hi) {
+        *a = hi;
+        if (*v > 0) *v = saturate16((int32_t)(-restitution * (float)*v));
+    }
+}
+
+// Puts balls pushed through a wall or the floor back inside, keeping them
+// in their cells. A push is not an impact, so nothing bounces.
+static void contain(Packed_Balls* p, int32_t radius)
+{
+    int32_t width = p->cells_x * CELL_UNITS, height = p->cells_y * CELL_UNITS;
+    for (int cy = 0; cy < p->cells_y; cy++) {
+        for (int cx = 0; cx < p->cells_x; cx++) {
+            int c = cy * p->cells_x + cx;
+            int32_t ox = cx * CELL_UNITS - OFFSET_BIAS, oy = cy * CELL_UNITS - OFFSET_BIAS;
+            for (int i = p->cell_start[c]; i < p->cell_start[c + 1]; i++) {
+                int32_t ax = ox + p->x[i], ay = oy + p->y[i];
+                bounce(&ax, &p->vx[i], radius, width - 1 - radius, 0.0f);
+                bounce(&ay, &p->vy[i], radius, height - 1 - radius, 0.0f);
+                p->x[i] = clamp_offset(ax - ox);
+                p->y[i] = clamp_offset(ay - oy);
+            }
+        }
+    }
+}
+
+// Adds the pushes since the positions were saved in next_x, next_y to the
+// velocities, as in position-based dynamics. A push may only slow a ball:
+// a deep overlap from a fast impact would otherwise come out as speed.
+static void take_pushes(Packed_Balls* p)
+{
+    for (int i = 0; i < p->count; i++) {
+        float vx = p->vx[i], vy = p->vy[i];
+        float nvx = vx + (float)((int32_t)p->x[i] - (int32_t)p->next_x[i]) / VELOCITY_TO_POSITION;
+        float nvy = vy + (float)((int32_t)p->y[i] - (int32_t)p->next_y[i]) / VELOCITY_TO_POSITION;
+        float before = vx * vx + vy * vy, after = nvx * nvx + nvy * nvy;
+        if (after > before) {
+            float scale = sqrtf(before / after);
+            nvx *= scale;
+            nvy *= scale;
+        }
+        p->vx[i] = saturate16((int32_t)lrintf(nvx));
+        p->vy[i] = saturate16((int32_t)lrintf(nvy));
+    }
+}
+
+void packed_step(Packed_Balls* p, float dt)
+{
+    int32_t radius = (int32_t)(p->radius * PACKED_POSITION_ONE);
+    int32_t gravity = (int32_t)lrintf(GRAVITY * dt * PACKED_VELOCITY_ONE);
+    int32_t width = p->cells_x * CELL_UNITS, height = p->cells_y * CELL_UNITS;
+    for (int cy = 0; cy < p->cells_y; cy++) {
+        for (int cx = 0; cx < p->cells_x; cx++) {
+            int c = cy * p->cells_x + cx;
+            for (int i = p->cell_start[c]; i < p->cell_start[c + 1]; i++) {
+                int16_t vx = p->vx[i], vy = saturate16(p->vy[i] + gravity);
+                int32_t ax = cx * CELL_UNITS + p->x[i] - OFFSET_BIAS + vx * VELOCITY_TO_POSITION;
+                int32_t ay = cy * CELL_UNITS + p->y[i] - OFFSET_BIAS + vy * VELOCITY_TO_POSITION;
+                bounce(&ax, &vx, radius, width - 1 - radius, PACKED_RESTITUTION);
+                bounce(&ay, &vy, radius, height - 1 - radius, PACKED_RESTITUTION);
+                stage(p, i, ax, ay, vx, vy);
+            }
+        }
+    }
+    rebucket(p);
+    for (int i = 0; i < p->count; i++) {
+        p->next_x[i] = p->x[i];
+        p->next_y[i] = p->y[i];
+    }
+    for (int k = 0; k < PACKED_ITERATIONS; k++) collide_cells(p, 2 * radius, false);
+    // The floor has to hold before the shock pass stacks rows on it.
+    contain(p, radius);
+    collide_cells(p, 2 * radius, true);
+    take_pushes(p);
+}
+
+float packed_mean_speed(const Packed_Balls* p)
+{
+    double sum = 0.0;
+    for (int i = 0; i < p->count; i++) sum += sqrt((double)p->vx[i] * p->vx[i] + (double)p->vy[i] * p->vy[i]);
+    return p->count > 0 ? (float)(sum / p->count / PACKED_VELOCITY_ONE) : 0.0f;
+}
@@ -0,0 +1,68 @@
+#ifndef PACKED_H
+#define PACKED_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "arena.h"
+
+// Compact ball state for very large uniform drills, run on its own field
+// with no legs. A Ball takes 32 bytes; a packed ball takes 8:
+//
+//     x, y     uint16  offset from its grid cell, 1 / PACKED_POSITION_ONE px,
+//                      biased so a ball may sit half a cell outside it
+//     vx, vy   int16   velocity, 1 / PACKED_VELOCITY_ONE px per frame
+//
+// Every ball shares one radius and gravity is the only acceleration, so
+// neither is stored. The cell is not stored either: balls are kept bucketed
+// by cell, cell c owning [cell_start[c], cell_start[c + 1]), and a counting
+// sort moves them between buckets after every step. Positions resolve to
+// 1/1024 px and velocities to 1/256 px per frame, up to PACKED_MAX_SPEED px
+// per frame.
+//
+// packed_step integrates on the fixed-point values, rebuckets, then pushes
+// overlapping pairs apart. Each ball is tested against the balls in its own
+// cell and the four cells after it, so every pair is seen once; a cell is
+// wider than a ball plus the half cell a push may carry it out, so no pair
+// is missed. PACKED_ITERATIONS passes split each push evenly; a last shock
+// pass runs from the floor up and gives the upper ball of a stacked pair the
+// whole push, so a deep pile stands on its floor instead of sinking into
+// it. The pushes are then added to the velocities, but may only slow a
+// ball. A ball pushed out of its cell changes bucket at the next step.
+// Walls and floor bounce with PACKED_RESTITUTION.
+
+#define PACKED_CELL_SIZE 32.0f
+#define PACKED_POSITION_ONE 1024.0f
+#define PACKED_VELOCITY_ONE 256.0f
+#define PACKED_MAX_SPEED (32767.0f / PACKED_VELOCITY_ONE)
+#define PACKED_RESTITUTION 0.5f
+#define PACKED_ITERATIONS 1
+#define PACKED_FIELD_FILL 0.25f
+
+typedef struct packed_balls {
+    uint16_t* x;
+    uint16_t* y;
+    int16_t* vx;
+    int16_t* vy;
+    // Scratch for the rebucketing sort.
+    uint16_t* next_x;
+    uint16_t* next_y;
+    int16_t* next_vx;
+    int16_t* next_vy;
+    int32_t* next_cell;
+    int32_t* cell_start;
+    int32_t* cell_fill;
+    int count;
+    int capacity;
+    int cells_x;
+    int cells_y;
+    float radius;
+} Packed_Balls;
+
+size_t packed_memory_size(int capacity, int cells_x, int cells_y);
+bool packed_init(Packed_Balls* p, Arena* a, int capacity, int cells_x, int cells_y, float radius);
+void packed_field_for(int count, float radius, int* cells_x, int* cells_y);
+void packed_fill(Packed_Balls* p, int count, uint32_t seed);
+void packed_step(Packed_Balls* p, float dt);
+float packed_mean_speed(const Packed_Balls* p);
+
+#endif
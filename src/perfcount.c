@@ -0,0 +1,134 @@
+#if defined(__linux__)
+#define _GNU_SOURCE
+#endif
+
+#include <string.h>
+#include "perfcount.h"
+
+#if defined(__linux__)
+#include <errno.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+const char* perf_counter_names[PERF_COUNTER_COUNT] = {
+    [PERF_CYCLES] = "cycles",
+    [PERF_INSTRUCTIONS] = "instructions",
+    [PERF_L1D_MISSES] = "l1d_misses",
+    [PERF_LLC_MISSES] = "llc_misses",
+    [PERF_BRANCH_MISSES] = "branch_misses",
+};
+
+#if defined(__linux__)
+
+static const struct {
+    uint32_t type;
+    uint64_t config;
+} perf_events[PERF_COUNTER_COUNT] = {
+    [PERF_CYCLES] = {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    [PERF_INSTRUCTIONS] = {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    [PERF_L1D_MISSES] = {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D
+        | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+    [PERF_LLC_MISSES] = {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+    [PERF_BRANCH_MISSES] = {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+};
+
+static const char* perf_error(int e)
+{
+    switch (e) {
+    case EACCES:
+    case EPERM: return "not permitted, see /proc/sys/kernel/perf_event_paranoid";
+    case ENOENT:
+    case EOPNOTSUPP: return "no hardware counters on this CPU or VM";
+    case ENOSYS: return "kernel built without perf events";
+    default: return strerror(e);
+    }
+}
+
+bool perf_open(Perf_Group* g, const char** error)
+{
+    g->leader = -1;
+    g->count = 0;
+    int first_error = 0;
+    for (int c = 0; c < PERF_COUNTER_COUNT; c++) {
+        g->fd[c] = -1;
+        g->slot[c] = -1;
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = perf_events[c].type;
+        attr.config = perf_events[c].config;
+        attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        attr.disabled = g->leader == -1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        int fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, g->leader, 0);
+        if (fd < 0) {
+            if (first_error == 0) first_error = errno;
+            continue;
+        }
+        if (g->leader == -1) g->leader = fd;
+        g->fd[c] = fd;
+        g->slot[c] = g->count++;
+    }
+    if (g->leader == -1) {
+        *error = perf_error(first_error);
+        return false;
+    }
+    ioctl(g->leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(g->leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    return true;
+}
+
+bool perf_read(const Perf_Group* g, Perf_Counters* out)
+{
+    // PERF_FORMAT_GROUP with both times: the number of counters, the time
+    // enabled and the time running, then the values in the order they
+    // joined the group.
+    uint64_t buffer[3 + PERF_COUNTER_COUNT];
+    if (read(g->leader, buffer, sizeof(buffer)) < (ssize_t)(sizeof(uint64_t) * (3 + (size_t)g->count))) return false;
+    out->enabled = buffer[1];
+    out->running = buffer[2];
+    for (int c = 0; c < PERF_COUNTER_COUNT; c++) {
+        out->value[c] = g->slot[c] >= 0 ? buffer[3 + g->slot[c]] : 0;
+    }
+    return true;
+}
+
+void perf_close(Perf_Group* g)
+{
+    for (int c = 0; c < PERF_COUNTER_COUNT; c++) {
+        if (g->fd[c] >= 0) close(g->fd[c]);
+        g->fd[c] = -1;
+        g->slot[c] = -1;
+    }
+    g->leader = -1;
+    g->count = 0;
+}
+
+#else
+
+bool perf_open(Perf_Group* g, const char** error)
+{
+    memset(g, 0, sizeof(*g));
+    for (int c = 0; c < PERF_COUNTER_COUNT; c++) g->fd[c] = g->slot[c] = -1;
+    g->leader = -1;
+    *error = "only supported on Linux";
+    return false;
+}
+
+bool perf_read(const Perf_Group* g, Perf_Counters* out)
+{
+    (void)g;
+    memset(out, 0, sizeof(*out));
+    return false;
+}
+
+void perf_close(Perf_Group* g)
+{
+    (void)g;
+}
+
+#endif
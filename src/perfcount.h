@@ -0,0 +1,93 @@
+#ifndef PERFCOUNT_H
+#define PERFCOUNT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Hardware performance counters for the calling thread, through Linux
+// perf_event_open. The counters are opened as one group so a single read
+// returns all of them from the same instant. Only user-space events are
+// counted, which the default perf_event_paranoid setting allows. A counter
+// the CPU, the kernel or a VM does not provide is left out of the group and
+// reads as zero; on other platforms perf_open always fails.
+//
+// When the PMU has fewer registers than there are counters in use, the
+// kernel time-slices groups and only counts this one part of the time.
+// Every read therefore also carries how long the group was enabled and how
+// long it was actually running. Sums of deltas keep both, and perf_scaled
+// extrapolates the count to the enabled time the way perf stat does. A
+// span in which the group never ran has running == 0 and no count at all,
+// which perf_measured tells apart from a true zero.
+
+typedef enum perf_counter {
+    PERF_CYCLES,
+    PERF_INSTRUCTIONS,
+    PERF_L1D_MISSES,
+    PERF_LLC_MISSES,
+    PERF_BRANCH_MISSES,
+    PERF_COUNTER_COUNT
+} Perf_Counter;
+
+typedef struct perf_counters {
+    uint64_t value[PERF_COUNTER_COUNT];
+    uint64_t enabled;
+    uint64_t running;
+} Perf_Counters;
+
+// slot[c] is the position of counter c in the group read, or -1.
+typedef struct perf_group {
+    int fd[PERF_COUNTER_COUNT];
+    int slot[PERF_COUNTER_COUNT];
+    int leader;
+    int count;
+} Perf_Group;
+
+extern const char* perf_counter_names[PERF_COUNTER_COUNT];
+
+// Opens and starts every counter it can. Returns false, with the reason in
+// error, if none could be opened.
+bool perf_open(Perf_Group* g, const char** error);
+bool perf_read(const Perf_Group* g, Perf_Counters* out);
+void perf_close(Perf_Group* g);
+
+static inline bool perf_has(const Perf_Group* g, Perf_Counter c)
+{
+    return g->slot[c] >= 0;
+}
+
+// Adds the span between two reads to sum, unscaled.
+static inline void perf_add_delta(Perf_Counters* sum, const Perf_Counters* now, const Perf_Counters* then)
+{
+    for (int c = 0; c < PERF_COUNTER_COUNT; c++) sum->value[c] += now->value[c] - then->value[c];
+    sum->enabled += now->enabled - then->enabled;
+    sum->running += now->running - then->running;
+}
+
+static inline void perf_add(Perf_Counters* sum, const Perf_Counters* c)
+{
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++) sum->value[i] += c->value[i];
+    sum->enabled += c->enabled;
+    sum->running += c->running;
+}
+
+// Whether the group counted at all over the summed spans.
+static inline bool perf_measured(const Perf_Counters* s)
+{
+    return s->running > 0;
+}
+
+// Whether the kernel multiplexed the group for part of the summed spans.
+static inline bool perf_multiplexed(const Perf_Counters* s)
+{
+    return s->running > 0 && s->running < s->enabled;
+}
+
+// Count extrapolated to the whole enabled time; 0 if never measured.
+static inline double perf_scaled(const Perf_Counters* s, Perf_Counter c)
+{
+    if (s->running == 0) return 0.0;
+    if (s->running >= s->enabled) return (double)s->value[c];
+    return (double)s->value[c] * (double)s->enabled / (double)s->running;
+}
+
+#endif
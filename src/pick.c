@@ -0,0 +1,150 @@
+#include "raylib.h"
+#include <math.h>
+#include "main.h"
+#include "pick.h"
+
+static uint32_t bucket_count_for(int joint_count)
+{
+    uint32_t n = PICK_MIN_BUCKETS;
+    while (n < (uint32_t)joint_count) n <<= 1;
+    return n;
+}
+
+static inline int cell_coord(float v)
+{
+    return (int)floorf(v * (1.0f / PICK_CELL_SIZE));
+}
+
+static inline int cell_bucket(const Pick_Grid* g, int cx, int cy)
+{
+    uint32_t h = ((uint32_t)cx * 73856093u) ^ ((uint32_t)cy * 19349663u);
+    return (int)(h & g->bucket_mask);
+}
+
+static inline int joint_bucket(const Pick_Grid* g, Vector2 p)
+{
+    return cell_bucket(g, cell_coord(p.x), cell_coord(p.y));
+}
+
+static inline void link_joint(Pick_Grid* g, int j, int b)
+{
+    int head = g->bucket_head[b];
+    g->prev[j] = -1;
+    g->next[j] = head;
+    if (head != -1) g->prev[head] = j;
+    g->bucket_head[b] = j;
+    g->joint_bucket[j] = b;
+}
+
+static inline void unlink_joint(Pick_Grid* g, int j)
+{
+    int b = g->joint_bucket[j];
+    if (g->prev[j] != -1) g->next[g->prev[j]] = g->next[j];
+    else g->bucket_head[b] = g->next[j];
+    if (g->next[j] != -1) g->prev[g->next[j]] = g->prev[j];
+}
+
+size_t pick_memory_size(int joint_count)
+{
+    return (size_t)bucket_count_for(joint_count) * sizeof(int) + (size_t)joint_count * 4 * sizeof(int) + 5 * 16;
+}
+
+bool pick_init(Pick_Grid* g, Arena* a, int joint_count)
+{
+    uint32_t buckets = bucket_count_for(joint_count);
+    *g = (Pick_Grid) {0};
+    g->bucket_head = ARENA_PUSH_ARRAY(a, int, buckets);
+    g->next = ARENA_PUSH_ARRAY(a, int, joint_count);
+    g->prev = ARENA_PUSH_ARRAY(a, int, joint_count);
+    g->joint_bucket = ARENA_PUSH_ARRAY(a, int, joint_count);
+    g->box_selection = ARENA_PUSH_ARRAY(a, int, joint_count);
+    g->bucket_mask = buckets - 1;
+    return g->bucket_head != NULL && g->next != NULL && g->prev != NULL
+        && g->joint_bucket != NULL && g->box_selection != NULL;
+}
+
+void pick_rebuild(Pick_Grid* g, const World* w)
+{
+    for (uint32_t b = 0; b <= g->bucket_mask; b++) g->bucket_head[b] = -1;
+    g->joint_count = w->joint_count;
+    g->box_selection_count = 0;
+    for (int j = 0; j < w->joint_count; j++) {
+        link_joint(g, j, joint_bucket(g, w->joints[j].centre_position));
+    }
+}
+
+void pick_refit(Pick_Grid* g, const World* w)
+{
+    if (g->joint_count != w->joint_count) {
+        pick_rebuild(g, w);
+        return;
+    }
+    for (int j = 0; j < w->joint_count; j++) {
+        int b = joint_bucket(g, w->joints[j].centre_position);
+        if (b == g->joint_bucket[j]) continue;
+        unlink_joint(g, j);
+        link_joint(g, j, b);
+    }
+}
+
+// Nearest pickable joint (one with a parent leg) whose centre lies within
+// radius of (x, y), or -1. Buckets may be visited twice when two cells
+// collide; that only repeats a distance test.
+int pick_nearest(const Pick_Grid* g, const World* w, float x, float y, float radius)
+{
+    int best = -1;
+    float best_d2 = radius * radius;
+    int cx0 = cell_coord(x - radius), cx1 = cell_coord(x + radius);
+    int cy0 = cell_coord(y - radius), cy1 = cell_coord(y + radius);
+    for (int cy = cy0; cy <= cy1; cy++) {
+        for (int cx = cx0; cx <= cx1; cx++) {
+            for (int j = g->bucket_head[cell_bucket(g, cx, cy)]; j != -1; j = g->next[j]) {
+                if (w->joints[j].connects_from == -1) continue;
+                Vector2 p = w->joints[j].centre_position;
+                float dx = p.x - x, dy = p.y - y;
+                float d2 = dx * dx + dy * dy;
+                if (d2 <= best_d2 && (best == -1 || d2 < best_d2 || j < best)) {
+                    best = j;
+                    best_d2 = d2;
+                }
+            }
+        }
+    }
+    return best;
+}
+
+// Collects every pickable joint inside the box into g->box_selection. A joint
+// is taken only while visiting its own cell, so colliding buckets cannot
+// report it twice. Boxes spanning more than PICK_MAX_BOX_CELLS cells scan the
+// joint array instead.
+int pick_box(Pick_Grid* g, const World* w, float x0, float y0, float x1, float y1)
+{
+    if (x1 < x0) { float t = x0; x0 = x1; x1 = t; }
+    if (y1 < y0) { float t = y0; y0 = y1; y1 = t; }
+    int cx0 = cell_coord(x0), cx1 = cell_coord(x1);
+    int cy0 = cell_coord(y0), cy1 = cell_coord(y1);
+    int n = 0;
+
+    if ((int64_t)(cx1 - cx0 + 1) * (cy1 - cy0 + 1) > PICK_MAX_BOX_CELLS) {
+        for (int j = 0; j < w->joint_count; j++) {
+            Vector2 p = w->joints[j].centre_position;
+            if (w->joints[j].connects_from == -1) continue;
+            if (p.x >= x0 && p.x <= x1 && p.y >= y0 && p.y <= y1) g->box_selection[n++] = j;
+        }
+        g->box_selection_count = n;
+        return n;
+    }
+
+    for (int cy = cy0; cy <= cy1; cy++) {
+        for (int cx = cx0; cx <= cx1; cx++) {
+            for (int j = g->bucket_head[cell_bucket(g, cx, cy)]; j != -1; j = g->next[j]) {
+                Vector2 p = w->joints[j].centre_position;
+                if (w->joints[j].connects_from == -1) continue;
+                if (cell_coord(p.x) != cx || cell_coord(p.y) != cy) continue;
+                if (p.x >= x0 && p.x <= x1 && p.y >= y0 && p.y <= y1) g->box_selection[n++] = j;
+            }
+        }
+    }
+    g->box_selection_count = n;
+    return n;
+}
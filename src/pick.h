@@ -0,0 +1,39 @@
+#ifndef PICK_H
+#define PICK_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "arena.h"
+
+// Spatial hash over joint positions for editor picking. Space is cut into
+// PICK_CELL_SIZE squares, each square hashes to a bucket, and every joint sits
+// on its bucket's doubly linked list. pick_refit only relinks joints whose
+// bucket changed since the last refit, so a still crowd costs one hash per
+// joint and a moving one adds an O(1) unlink/link per joint that moved.
+
+#define PICK_CELL_SIZE 32.0f
+#define PICK_MIN_BUCKETS 256
+#define PICK_MAX_BOX_CELLS 4096
+
+typedef struct pick_grid {
+    int* bucket_head;
+    int* next;
+    int* prev;
+    int* joint_bucket;
+    int* box_selection;
+    uint32_t bucket_mask;
+    int joint_count;
+    int box_selection_count;
+} Pick_Grid;
+
+struct world;
+
+size_t pick_memory_size(int joint_count);
+bool pick_init(Pick_Grid* g, Arena* a, int joint_count);
+void pick_rebuild(Pick_Grid* g, const struct world* w);
+void pick_refit(Pick_Grid* g, const struct world* w);
+int pick_nearest(const Pick_Grid* g, const struct world* w, float x, float y, float radius);
+int pick_box(Pick_Grid* g, const struct world* w, float x0, float y0, float x1, float y1);
+
+#endif
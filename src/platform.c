@@ -0,0 +1,249 @@
+#if !defined(_WIN32)
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <stdio.h>
+#include "platform.h"
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <pthread.h>
+#endif
+
+uint64_t platform_now_ns(void)
+{
+#if defined(_WIN32)
+    static LARGE_INTEGER freq;
+    LARGE_INTEGER now;
+    if (freq.QuadPart == 0) QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&now);
+    return (uint64_t)((double)now.QuadPart * 1e9 / (double)freq.QuadPart);
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+bool platform_map_file(const char* path, Platform_Mapping* m)
+{
+    *m = (Platform_Mapping) {0};
+#if defined(_WIN32)
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) return false;
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+        CloseHandle(file);
+        return false;
+    }
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+    CloseHandle(file);
+    if (mapping == NULL) return false;
+    void* data = MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+    if (data == NULL) {
+        CloseHandle(mapping);
+        return false;
+    }
+    m->data = data;
+    m->size = (size_t)size.QuadPart;
+    m->handle = mapping;
+    return true;
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        return false;
+    }
+    void* data = mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) return false;
+    m->data = data;
+    m->size = (size_t)st.st_size;
+    return true;
+#endif
+}
+
+void platform_unmap_file(Platform_Mapping* m)
+{
+    if (m->data == NULL) return;
+#if defined(_WIN32)
+    UnmapViewOfFile(m->data);
+    CloseHandle((HANDLE)m->handle);
+#else
+    munmap(m->data, m->size);
+#endif
+    *m = (Platform_Mapping) {0};
+}
+
+#if defined(_WIN32)
+static HANDLE shared_mapping(const char* name, size_t size, bool create)
+{
+    char path[256];
+    snprintf(path, sizeof(path), "Local\\%s", name);
+    if (!create) return OpenFileMappingA(FILE_MAP_READ, FALSE, path);
+    return CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE,
+        (DWORD)((uint64_t)size >> 32), (DWORD)size, path);
+}
+#endif
+
+bool platform_create_shared(const char* name, size_t size, Platform_Mapping* m)
+{
+    *m = (Platform_Mapping) {0};
+#if defined(_WIN32)
+    HANDLE mapping = shared_mapping(name, size, true);
+    if (mapping == NULL) return false;
+    void* data = MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, size);
+    if (data == NULL) {
+        CloseHandle(mapping);
+        return false;
+    }
+    m->handle = mapping;
+#else
+    char path[256];
+    snprintf(path, sizeof(path), "/%s", name);
+    int fd = shm_open(path, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) return false;
+    if (ftruncate(fd, (off_t)size) != 0) {
+        close(fd);
+        return false;
+    }
+    void* data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) return false;
+#endif
+    m->data = data;
+    m->size = size;
+    return true;
+}
+
+bool platform_open_shared(const char* name, Platform_Mapping* m)
+{
+    *m = (Platform_Mapping) {0};
+#if defined(_WIN32)
+    HANDLE mapping = shared_mapping(name, 0, false);
+    if (mapping == NULL) return false;
+    void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    MEMORY_BASIC_INFORMATION info;
+    if (data == NULL || VirtualQuery(data, &info, sizeof(info)) == 0) {
+        if (data != NULL) UnmapViewOfFile(data);
+        CloseHandle(mapping);
+        return false;
+    }
+    m->handle = mapping;
+    m->size = info.RegionSize;
+#else
+    char path[256];
+    snprintf(path, sizeof(path), "/%s", name);
+    int fd = shm_open(path, O_RDONLY, 0);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        return false;
+    }
+    void* data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) return false;
+    m->size = (size_t)st.st_size;
+#endif
+    m->data = data;
+    return true;
+}
+
+void platform_unlink_shared(const char* name)
+{
+#if defined(_WIN32)
+    (void)name;
+#else
+    char path[256];
+    snprintf(path, sizeof(path), "/%s", name);
+    shm_unlink(path);
+#endif
+}
+
+void platform_sleep_ns(uint64_t ns)
+{
+#if defined(_WIN32)
+    Sleep((DWORD)(ns / 1000000ull));
+#else
+    struct timespec ts = {(time_t)(ns / 1000000000ull), (long)(ns % 1000000000ull)};
+    nanosleep(&ts, NULL);
+#endif
+}
+
+int platform_cpu_count(void)
+{
+#if defined(_WIN32)
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return (int)info.dwNumberOfProcessors;
+#else
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+#endif
+}
+
+typedef struct parallel_job {
+    Platform_Thread_Fn fn;
+    void* arg;
+    int index;
+} Parallel_Job;
+
+#if defined(_WIN32)
+static DWORD WINAPI parallel_entry(LPVOID p)
+{
+    Parallel_Job* job = p;
+    job->fn(job->arg, job->index);
+    return 0;
+}
+#else
+static void* parallel_entry(void* p)
+{
+    Parallel_Job* job = p;
+    job->fn(job->arg, job->index);
+    return NULL;
+}
+#endif
+
+void platform_run_parallel(int thread_count, Platform_Thread_Fn fn, void* arg)
+{
+    if (thread_count > PLATFORM_MAX_THREADS) thread_count = PLATFORM_MAX_THREADS;
+    Parallel_Job jobs[PLATFORM_MAX_THREADS];
+#if defined(_WIN32)
+    HANDLE threads[PLATFORM_MAX_THREADS];
+#else
+    pthread_t threads[PLATFORM_MAX_THREADS];
+#endif
+    bool started[PLATFORM_MAX_THREADS] = {false};
+
+    for (int i = 1; i < thread_count; i++) {
+        jobs[i] = (Parallel_Job) {.fn = fn, .arg = arg, .index = i};
+#if defined(_WIN32)
+        threads[i] = CreateThread(NULL, 0, parallel_entry, &jobs[i], 0, NULL);
+        started[i] = threads[i] != NULL;
+#else
+        started[i] = pthread_create(&threads[i], NULL, parallel_entry, &jobs[i]) == 0;
+#endif
+        // A thread we could not start still has its share of the work done.
+        if (!started[i]) fn(arg, i);
+    }
+    fn(arg, 0);
+    for (int i = 1; i < thread_count; i++) {
+        if (!started[i]) continue;
+#if defined(_WIN32)
+        WaitForSingleObject(threads[i], INFINITE);
+        CloseHandle(threads[i]);
+#else
+        pthread_join(threads[i], NULL);
+#endif
+    }
+}
@@ -0,0 +1,42 @@
+#ifndef PLATFORM_H
+#define PLATFORM_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// OS services the game needs that raylib does not provide. Kept in its own
+// translation unit so windows.h and raylib.h never meet.
+
+#define PLATFORM_MAX_THREADS 64
+
+// A private, copy-on-write view of a whole file. Writes through data are
+// visible only to this process and never reach the file.
+typedef struct platform_mapping {
+    void* data;
+    size_t size;
+    void* handle;
+} Platform_Mapping;
+
+// Runs fn(arg, i) for i in [0, thread_count) on thread_count threads
+// (the caller runs i = 0) and returns when all of them have finished.
+typedef void (*Platform_Thread_Fn)(void* arg, int index);
+
+uint64_t platform_now_ns(void);
+
+bool platform_map_file(const char* path, Platform_Mapping* m);
+void platform_unmap_file(Platform_Mapping* m);
+
+// Named memory shared between processes. The creator sizes it and maps it
+// read-write; anyone else opens it by name read-only. The name disappears
+// with platform_unlink_shared, or on Windows with the last handle to it.
+bool platform_create_shared(const char* name, size_t size, Platform_Mapping* m);
+bool platform_open_shared(const char* name, Platform_Mapping* m);
+void platform_unlink_shared(const char* name);
+
+void platform_sleep_ns(uint64_t ns);
+
+int platform_cpu_count(void);
+void platform_run_parallel(int thread_count, Platform_Thread_Fn fn, void* arg);
+
+#endif
@@ -0,0 +1,316 @@
+#include "raylib.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "profiler.h"
+
+const char* prof_zone_names[PROF_ZONE_COUNT] = {
+    [PROF_FRAME] = "frame",
+    [PROF_SELECT_JOINT] = "select_joint",
+    [PROF_REORDER_BALLS] = "reorder_balls",
+    [PROF_ANIM_SAMPLE] = "anim_sample",
+    [PROF_XPBD_STEP] = "xpbd_step",
+    [PROF_EVENTS] = "events",
+    [PROF_BLEND_POSES] = "blend_poses",
+    [PROF_UPDATE_JOINT_POSITIONS] = "update_joint_positions",
+    [PROF_HANDLE_LEG_ELEMENTS] = "handle_leg_elements",
+    [PROF_UPDATE_PICKING] = "update_picking",
+    [PROF_PACKED_STEP] = "packed_step",
+    [PROF_DRAW] = "draw",
+    [PROF_PRESENT] = "present",
+};
+
+uint32_t prof_frame_index;
+__thread Prof_Thread* prof_tls;
+
+static Prof_Thread* prof_threads[PROF_MAX_THREADS];
+static int prof_thread_count;
+static uint64_t prof_base_ticks;
+static double prof_ns_per_tick = 1.0;
+static uint64_t prof_last_frame[PROF_ZONE_COUNT];
+static bool prof_overlay_visible = true;
+static Histogram prof_hist[PROF_ZONE_COUNT];
+static Perf_Group prof_perf;
+static bool prof_counters_on;
+static Perf_Counters prof_last_counters[PROF_ZONE_COUNT];
+static Perf_Counters prof_counter_sum[PROF_ZONE_COUNT];
+
+static const double prof_percentiles[] = {50.0, 90.0, 99.0, 99.9};
+#define PROF_PERCENTILE_COUNT (int)(sizeof(prof_percentiles) / sizeof(prof_percentiles[0]))
+
+void prof_register_thread(void)
+{
+    if (prof_tls != NULL) return;
+    int id = __atomic_fetch_add(&prof_thread_count, 1, __ATOMIC_RELAXED);
+    if (id >= PROF_MAX_THREADS) {
+        fprintf(stderr, "profiler: more than %d threads, zones on this thread are dropped\n", PROF_MAX_THREADS);
+        static __thread Prof_Thread overflow;
+        prof_tls = &overflow;
+        return;
+    }
+    Prof_Thread* t = calloc(1, sizeof(Prof_Thread));
+    t->id = id;
+    prof_threads[id] = t;
+    prof_tls = t;
+}
+
+void prof_init(void)
+{
+    // Calibrate the cycle counter against the OS monotonic clock.
+    uint64_t ns0 = platform_now_ns();
+    uint64_t t0 = prof_ticks();
+    while (platform_now_ns() - ns0 < 10000000ull) { }
+    uint64_t ns1 = platform_now_ns();
+    uint64_t t1 = prof_ticks();
+    if (t1 > t0) prof_ns_per_tick = (double)(ns1 - ns0) / (double)(t1 - t0);
+
+    prof_base_ticks = t1;
+    prof_frame_index = 0;
+    for (int i = 0; i < PROF_ZONE_COUNT; i++) hist_reset(&prof_hist[i]);
+    prof_register_thread();
+}
+
+// Counts on the calling thread only; zones on other threads keep to timings.
+bool prof_enable_counters(void)
+{
+    const char* error = NULL;
+    if (!perf_open(&prof_perf, &error)) {
+        printf("profiler: hardware counters unavailable, %s; reporting timings only\n", error);
+        return false;
+    }
+    for (int c = 0; c < PERF_COUNTER_COUNT; c++) {
+        if (!perf_has(&prof_perf, c)) printf("profiler: counter %s not available\n", perf_counter_names[c]);
+    }
+    memset(prof_counter_sum, 0, sizeof(prof_counter_sum));
+    prof_tls->counting = true;
+    prof_counters_on = true;
+    return true;
+}
+
+void prof_read_counters(Perf_Counters* out)
+{
+    perf_read(&prof_perf, out);
+}
+
+void prof_count_zone(Prof_Thread* t, int zone, int depth)
+{
+    Perf_Counters now;
+    prof_read_counters(&now);
+    perf_add_delta(&t->frame_counters[zone], &now, &t->open_counters[depth]);
+}
+
+double prof_ticks_to_ms(uint64_t ticks)
+{
+    return (double)ticks * prof_ns_per_tick * 1e-6;
+}
+
+uint64_t prof_last_frame_ticks(Prof_Zone zone)
+{
+    return prof_last_frame[zone];
+}
+
+void prof_frame_end(void)
+{
+    Prof_Thread* t = prof_tls;
+    for (int i = 0; i < PROF_ZONE_COUNT; i++) {
+        prof_last_frame[i] = t->frame_ticks[i];
+        if (t->frame_ticks[i] != 0) {
+            hist_record(&prof_hist[i], (uint64_t)((double)t->frame_ticks[i] * prof_ns_per_tick));
+        }
+        t->frame_ticks[i] = 0;
+        if (t->counting) {
+            prof_last_counters[i] = t->frame_counters[i];
+            perf_add(&prof_counter_sum[i], &t->frame_counters[i]);
+            memset(&t->frame_counters[i], 0, sizeof(Perf_Counters));
+        }
+    }
+    prof_frame_index++;
+}
+
+const Histogram* prof_zone_histogram(Prof_Zone zone)
+{
+    return &prof_hist[zone];
+}
+
+void prof_write_report(FILE* f)
+{
+    fprintf(f, "%-24s %8s %9s %9s %9s %9s %9s %9s\n",
+        "zone (ms)", "samples", "mean", "p50", "p90", "p99", "p99.9", "max");
+    for (int i = 0; i < PROF_ZONE_COUNT; i++) {
+        const Histogram* h = &prof_hist[i];
+        if (h->count == 0) continue;
+        fprintf(f, "%-24s %8llu %9.4f", prof_zone_names[i], (unsigned long long)h->count, hist_mean(h) * 1e-6);
+        for (int p = 0; p < PROF_PERCENTILE_COUNT; p++) {
+            fprintf(f, " %9.4f", (double)hist_percentile(h, prof_percentiles[p]) * 1e-6);
+        }
+        fprintf(f, " %9.4f\n", (double)h->max * 1e-6);
+    }
+    uint32_t dropped = 0;
+    int thread_count = prof_thread_count < PROF_MAX_THREADS ? prof_thread_count : PROF_MAX_THREADS;
+    for (int ti = 0; ti < thread_count; ti++) {
+        if (prof_threads[ti] != NULL) dropped += prof_threads[ti]->dropped;
+    }
+    if (dropped > 0) fprintf(f, "profiler: %u zones nested deeper than %d were dropped\n", dropped, PROF_MAX_DEPTH);
+    if (!prof_counters_on) return;
+
+    // Counter means over the frames each zone ran in, in thousands, scaled
+    // up where the kernel multiplexed the group; "counted" is the share of
+    // the zone's time the group was actually counting.
+    fprintf(f, "%-24s %10s %10s %6s %10s %10s %10s %8s\n",
+        "zone (k per frame)", "cycles", "instr", "IPC", "l1d miss", "llc miss", "br miss", "counted");
+    for (int i = 0; i < PROF_ZONE_COUNT; i++) {
+        const Histogram* h = &prof_hist[i];
+        if (h->count == 0) continue;
+        const Perf_Counters* sum = &prof_counter_sum[i];
+        fprintf(f, "%-24s", prof_zone_names[i]);
+        if (!perf_measured(sum)) {
+            fprintf(f, " %10s %10s %6s %10s %10s %10s %8s\n", "-", "-", "-", "-", "-", "-", "never");
+            continue;
+        }
+        double mean[PERF_COUNTER_COUNT];
+        for (int c = 0; c < PERF_COUNTER_COUNT; c++) mean[c] = perf_scaled(sum, c) / (double)h->count;
+        for (int c = 0; c < PERF_COUNTER_COUNT; c++) {
+            if (c == PERF_L1D_MISSES) {
+                if (perf_has(&prof_perf, PERF_CYCLES) && perf_has(&prof_perf, PERF_INSTRUCTIONS) && mean[PERF_CYCLES] > 0.0) {
+                    fprintf(f, " %6.2f", mean[PERF_INSTRUCTIONS] / mean[PERF_CYCLES]);
+                } else {
+                    fprintf(f, " %6s", "-");
+                }
+            }
+            if (perf_has(&prof_perf, c)) fprintf(f, " %10.1f", mean[c] * 1e-3);
+            else fprintf(f, " %10s", "-");
+        }
+        fprintf(f, " %7.1f%%\n", 100.0 * (double)sum->running / (double)sum->enabled);
+    }
+}
+
+bool prof_write_stats_json(const char* path)
+{
+    FILE* f = fopen(path, "w");
+    if (f == NULL) return false;
+
+    fprintf(f, "{\"unit\":\"ns\",\"frames\":%u,\"zones\":{", prof_frame_index);
+    bool first = true;
+    for (int i = 0; i < PROF_ZONE_COUNT; i++) {
+        const Histogram* h = &prof_hist[i];
+        if (h->count == 0) continue;
+        fprintf(f, "%s\n  \"%s\":{\"count\":%llu,\"mean\":%.1f,\"min\":%llu,\"p50\":%llu,\"p90\":%llu,\"p99\":%llu,\"p99.9\":%llu,\"max\":%llu",
+            first ? "" : ",", prof_zone_names[i],
+            (unsigned long long)h->count, hist_mean(h), (unsigned long long)h->min,
+            (unsigned long long)hist_percentile(h, 50.0), (unsigned long long)hist_percentile(h, 90.0),
+            (unsigned long long)hist_percentile(h, 99.0), (unsigned long long)hist_percentile(h, 99.9),
+            (unsigned long long)h->max);
+        // Zones the group never counted in get no counters rather than zeros.
+        const Perf_Counters* sum = &prof_counter_sum[i];
+        if (prof_counters_on && perf_measured(sum)) {
+            fprintf(f, ",\"counted\":%.4f,\"counters\":{", (double)sum->running / (double)sum->enabled);
+            bool first_counter = true;
+            for (int c = 0; c < PERF_COUNTER_COUNT; c++) {
+                if (!perf_has(&prof_perf, c)) continue;
+                fprintf(f, "%s\"%s\":%.1f", first_counter ? "" : ",", perf_counter_names[c],
+                    perf_scaled(sum, c) / (double)h->count);
+                first_counter = false;
+            }
+            fprintf(f, "}");
+        }
+        fprintf(f, "}");
+        first = false;
+    }
+    fprintf(f, "\n}}\n");
+    return fclose(f) == 0;
+}
+
+void prof_shutdown(void)
+{
+    prof_write_report(stdout);
+    if (prof_write_stats_json(PROF_STATS_FILE)) {
+        printf("profiler: wrote percentiles to %s\n", PROF_STATS_FILE);
+    }
+    if (prof_counters_on) {
+        prof_tls->counting = false;
+        prof_counters_on = false;
+        perf_close(&prof_perf);
+    }
+}
+
+bool prof_dump_chrome_trace(const char* path, uint32_t frames)
+{
+    FILE* f = fopen(path, "w");
+    if (f == NULL) return false;
+
+    uint32_t first_frame = prof_frame_index > frames ? prof_frame_index - frames : 0;
+    bool first = true;
+    int thread_count = prof_thread_count < PROF_MAX_THREADS ? prof_thread_count : PROF_MAX_THREADS;
+
+    fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    for (int ti = 0; ti < thread_count; ti++) {
+        Prof_Thread* t = prof_threads[ti];
+        if (t == NULL) continue;
+        uint32_t count = t->head < PROF_RING_SIZE ? t->head : PROF_RING_SIZE;
+        for (uint32_t i = t->head - count; i != t->head; i++) {
+            Prof_Event* e = &t->ring[i & (PROF_RING_SIZE - 1)];
+            if (e->frame < first_frame || e->start < prof_base_ticks) continue;
+            double ts = (double)(e->start - prof_base_ticks) * prof_ns_per_tick * 1e-3;
+            double dur = (double)(e->end - e->start) * prof_ns_per_tick * 1e-3;
+            fprintf(f, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":0,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"frame\":%u}}",
+                first ? "" : ",\n", prof_zone_names[e->zone], t->id, ts, dur, e->frame);
+            first = false;
+        }
+    }
+    fprintf(f, "\n]}\n");
+    return fclose(f) == 0;
+}
+
+void prof_handle_keys(void)
+{
+    if (IsKeyPressed(PROF_KEY_OVERLAY)) prof_overlay_visible = !prof_overlay_visible;
+    if (IsKeyPressed(PROF_KEY_DUMP)) {
+        if (prof_dump_chrome_trace(PROF_TRACE_FILE, PROF_TRACE_FRAMES)) {
+            printf("profiler: wrote last %d frames to %s\n", PROF_TRACE_FRAMES, PROF_TRACE_FILE);
+        } else {
+            printf("profiler: could not write %s\n", PROF_TRACE_FILE);
+        }
+    }
+}
+
+void prof_draw_overlay(int x, int y)
+{
+    if (!prof_overlay_visible) return;
+
+    const int bar_max = 120;
+    const int row_h = 12;
+    const double budget_ms = 1000.0 / 60.0;
+    // Last frame's counters, in thousands, to the right of the timings.
+    const int counters_x = x + bar_max + 470;
+    DrawRectangle(x - 4, y - 4, bar_max + (prof_counters_on ? 700 : 470), (PROF_ZONE_COUNT + 1) * row_h + 8, Fade(BLACK, 0.5f));
+    DrawText(TextFormat("%-22s %7s %7s %7s %7s %7s %7s", "zone (ms)", "last", "p50", "p90", "p99", "p99.9", "max"),
+        x + bar_max + 6, y, 10, RAYWHITE);
+    if (prof_counters_on) {
+        DrawText(TextFormat("%6s %9s %9s %9s", "IPC", "k l1d", "k llc", "k br"), counters_x, y, 10, RAYWHITE);
+    }
+    for (int i = 0; i < PROF_ZONE_COUNT; i++) {
+        const Histogram* h = &prof_hist[i];
+        double ms = prof_ticks_to_ms(prof_last_frame[i]);
+        int w = (int)(bar_max * ms / budget_ms);
+        if (w > bar_max) w = bar_max;
+        if (w < 1 && ms > 0.0) w = 1;
+        int row = y + (i + 1) * row_h;
+        DrawRectangle(x, row, w, row_h - 2, i == PROF_FRAME ? ORANGE : YELLOW);
+        DrawText(TextFormat("%-22s %7.3f %7.3f %7.3f %7.3f %7.3f %7.3f", prof_zone_names[i], ms,
+            (double)hist_percentile(h, 50.0) * 1e-6, (double)hist_percentile(h, 90.0) * 1e-6,
+            (double)hist_percentile(h, 99.0) * 1e-6, (double)hist_percentile(h, 99.9) * 1e-6,
+            (double)h->max * 1e-6), x + bar_max + 6, row, 10, RAYWHITE);
+        if (prof_counters_on && prof_last_frame[i] != 0) {
+            const Perf_Counters* v = &prof_last_counters[i];
+            if (!perf_measured(v)) {
+                DrawText(TextFormat("%6s %9s %9s %9s", "-", "-", "-", "-"), counters_x, row, 10, GRAY);
+                continue;
+            }
+            double cycles = perf_scaled(v, PERF_CYCLES);
+            double ipc = cycles > 0.0 ? perf_scaled(v, PERF_INSTRUCTIONS) / cycles : 0.0;
+            DrawText(TextFormat("%6.2f %9.1f %9.1f %9.1f", ipc, perf_scaled(v, PERF_L1D_MISSES) * 1e-3,
+                perf_scaled(v, PERF_LLC_MISSES) * 1e-3, perf_scaled(v, PERF_BRANCH_MISSES) * 1e-3),
+                counters_x, row, 10, perf_multiplexed(v) ? YELLOW : RAYWHITE);
+        }
+    }
+}
@@ -0,0 +1,160 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include "platform.h"
+#include "histogram.h"
+#include "perfcount.h"
+
+// Scoped frame profiler. Zones are opened and closed with PROF_BEGIN/PROF_END
+// and may nest. Each closed zone is written to the calling thread's ring
+// buffer as a (start, end) pair of raw cycle counter ticks. Build without
+// PROFILER_ENABLED and every macro below expands to nothing.
+//
+// PROF_ENABLE_COUNTERS also reads the hardware counters of perfcount.h as
+// each zone opens and closes on the calling thread and adds the difference
+// to the zone, next to its time. The reads sit outside the zone's own ticks
+// but inside its parent's. Without counters the profiler says why and keeps
+// to timings.
+
+#define PROF_RING_SIZE 16384
+#define PROF_MAX_DEPTH 16
+#define PROF_MAX_THREADS 16
+#define PROF_TRACE_FRAMES 120
+
+#define PROF_KEY_OVERLAY KEY_F1
+#define PROF_KEY_DUMP KEY_F2
+#define PROF_TRACE_FILE "maradonna_trace.json"
+#define PROF_STATS_FILE "maradonna_stats.json"
+
+typedef enum prof_zone {
+    PROF_FRAME,
+    PROF_SELECT_JOINT,
+    PROF_REORDER_BALLS,
+    PROF_ANIM_SAMPLE,
+    PROF_XPBD_STEP,
+    PROF_EVENTS,
+    PROF_BLEND_POSES,
+    PROF_UPDATE_JOINT_POSITIONS,
+    PROF_HANDLE_LEG_ELEMENTS,
+    PROF_UPDATE_PICKING,
+    PROF_PACKED_STEP,
+    PROF_DRAW,
+    PROF_PRESENT,
+    PROF_ZONE_COUNT
+} Prof_Zone;
+
+typedef struct prof_event {
+    uint64_t start;
+    uint64_t end;
+    uint32_t frame;
+    uint16_t zone;
+    uint16_t depth;
+} Prof_Event;
+
+typedef struct prof_thread {
+    uint64_t open_start[PROF_MAX_DEPTH];
+    uint16_t open_zone[PROF_MAX_DEPTH];
+    int depth;
+    uint32_t dropped;
+    uint32_t head;
+    int id;
+    uint64_t frame_ticks[PROF_ZONE_COUNT];
+    bool counting;
+    Perf_Counters open_counters[PROF_MAX_DEPTH];
+    Perf_Counters frame_counters[PROF_ZONE_COUNT];
+    Prof_Event ring[PROF_RING_SIZE];
+} Prof_Thread;
+
+extern const char* prof_zone_names[PROF_ZONE_COUNT];
+extern uint32_t prof_frame_index;
+extern __thread Prof_Thread* prof_tls;
+
+static inline uint64_t prof_ticks(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __builtin_ia32_rdtsc();
+#elif defined(__aarch64__)
+    uint64_t v;
+    __asm__ volatile("mrs %0, cntvct_el0" : "=r"(v));
+    return v;
+#else
+    return platform_now_ns();
+#endif
+}
+
+void prof_init(void);
+void prof_register_thread(void);
+bool prof_enable_counters(void);
+void prof_read_counters(Perf_Counters* out);
+void prof_count_zone(Prof_Thread* t, int zone, int depth);
+void prof_frame_end(void);
+double prof_ticks_to_ms(uint64_t ticks);
+uint64_t prof_last_frame_ticks(Prof_Zone zone);
+bool prof_dump_chrome_trace(const char* path, uint32_t frames);
+void prof_handle_keys(void);
+void prof_draw_overlay(int x, int y);
+
+// Every zone's per-frame total is recorded in nanoseconds into a histogram at
+// prof_frame_end. Frames in which a zone did not run are not recorded.
+const Histogram* prof_zone_histogram(Prof_Zone zone);
+void prof_write_report(FILE* f);
+bool prof_write_stats_json(const char* path);
+void prof_shutdown(void);
+
+static inline void prof_begin(Prof_Zone zone)
+{
+    Prof_Thread* t = prof_tls;
+    int d = t->depth++;
+    // Zones nested deeper than PROF_MAX_DEPTH are counted and dropped; the
+    // depth still moves so the matching prof_end drops the same zone.
+    if (d >= PROF_MAX_DEPTH) {
+        t->dropped++;
+        return;
+    }
+    t->open_zone[d] = (uint16_t)zone;
+    if (t->counting) prof_read_counters(&t->open_counters[d]);
+    t->open_start[d] = prof_ticks();
+}
+
+static inline void prof_end(void)
+{
+    uint64_t end = prof_ticks();
+    Prof_Thread* t = prof_tls;
+    int d = --t->depth;
+    if (d >= PROF_MAX_DEPTH) return;
+    Prof_Event* e = &t->ring[t->head++ & (PROF_RING_SIZE - 1)];
+    e->start = t->open_start[d];
+    e->end = end;
+    e->frame = prof_frame_index;
+    e->zone = t->open_zone[d];
+    e->depth = (uint16_t)d;
+    t->frame_ticks[e->zone] += end - e->start;
+    if (t->counting) prof_count_zone(t, e->zone, d);
+}
+
+#ifdef PROFILER_ENABLED
+#define PROF_INIT() prof_init()
+#define PROF_THREAD() prof_register_thread()
+#define PROF_ENABLE_COUNTERS() prof_enable_counters()
+#define PROF_BEGIN(zone) prof_begin(zone)
+#define PROF_END() prof_end()
+#define PROF_FRAME_END() prof_frame_end()
+#define PROF_HANDLE_KEYS() prof_handle_keys()
+#define PROF_DRAW_OVERLAY(x, y) prof_draw_overlay(x, y)
+#define PROF_SHUTDOWN() prof_shutdown()
+#else
+#define PROF_INIT() ((void)0)
+#define PROF_THREAD() ((void)0)
+#define PROF_ENABLE_COUNTERS() ((void)0)
+#define PROF_BEGIN(zone) ((void)0)
+#define PROF_END() ((void)0)
+#define PROF_FRAME_END() ((void)0)
+#define PROF_HANDLE_KEYS() ((void)0)
+#define PROF_DRAW_OVERLAY(x, y) ((void)0)
+#define PROF_SHUTDOWN() ((void)0)
+#endif
+
+#endif
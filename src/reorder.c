@@ -0,0 +1,150 @@
+#include "raylib.h"
+#include "raymath.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "main.h"
+#include "reorder.h"
+#include "morton.h"
+
+typedef struct order_entry {
+    uint32_t code;
+    int32_t ball;
+} Order_Entry;
+
+typedef struct cache_entry {
+    uint32_t key;
+    float impulse;
+} Cache_Entry;
+
+typedef struct manifold_entry {
+    uint64_t key;
+    Vector2 point;
+    Vector2 normal;
+    float impulse;
+} Manifold_Entry;
+
+static int compare_order(const void* a, const void* b)
+{
+    const Order_Entry* x = a;
+    const Order_Entry* y = b;
+    if (x->code != y->code) return (x->code > y->code) - (x->code < y->code);
+    return x->ball - y->ball;
+}
+
+static int compare_cache(const void* a, const void* b)
+{
+    uint32_t x = ((const Cache_Entry*)a)->key, y = ((const Cache_Entry*)b)->key;
+    return (x > y) - (x < y);
+}
+
+static int compare_manifold(const void* a, const void* b)
+{
+    uint64_t x = ((const Manifold_Entry*)a)->key, y = ((const Manifold_Entry*)b)->key;
+    return (x > y) - (x < y);
+}
+
+// data[i] = old data[order[i].ball], through tmp.
+static void permute(void* data, size_t stride, const Order_Entry* order, int n, unsigned char* tmp)
+{
+    unsigned char* d = data;
+    memcpy(tmp, d, stride * (size_t)n);
+    for (int i = 0; i < n; i++) memcpy(d + stride * (size_t)i, tmp + stride * (size_t)order[i].ball, stride);
+}
+
+static void remap_contacts(Contact_Cache* c, const int* new_index, Cache_Entry* e)
+{
+    for (int k = 0; k < c->count; k++) {
+        uint32_t a = new_index[c->key[k] >> 16], b = c->key[k] & 0xffff;
+        if (b < CONTACT_FLOOR) {
+            b = new_index[b];
+            if (a > b) {
+                uint32_t t = a;
+                a = b;
+                b = t;
+            }
+        }
+        e[k] = (Cache_Entry) {a << 16 | b, c->impulse[k]};
+    }
+    qsort(e, c->count, sizeof(Cache_Entry), compare_cache);
+    for (int k = 0; k < c->count; k++) {
+        c->key[k] = e[k].key;
+        c->impulse[k] = e[k].impulse;
+    }
+}
+
+static void remap_manifold(Leg_Manifold* m, const int* new_index, Manifold_Entry* e)
+{
+    for (int k = 0; k < m->count; k++) {
+        uint64_t ball = (uint64_t)new_index[m->key[k] >> 32];
+        e[k] = (Manifold_Entry) {ball << 32 | (m->key[k] & 0xffffffffu), m->point[k], m->normal[k], m->impulse[k]};
+    }
+    qsort(e, m->count, sizeof(Manifold_Entry), compare_manifold);
+    for (int k = 0; k < m->count; k++) {
+        m->key[k] = e[k].key;
+        m->point[k] = e[k].point;
+        m->normal[k] = e[k].normal;
+        m->impulse[k] = e[k].impulse;
+    }
+}
+
+// Cells are fixed in world space, so a ball's code only changes when the
+// ball itself moves; far-off balls are clamped into the outer cells.
+static uint32_t reorder_cell(float v)
+{
+    float cell = floorf(v * (1.0f / REORDER_CELL_SIZE)) + 32768.0f;
+    return (uint32_t)Clamp(cell, 0.0f, 65535.0f);
+}
+
+// Call at a frame boundary, when no stage holds ball indices.
+void reorder_balls(World* w)
+{
+    Ball_Order* o = &w->ball_order;
+    int n = w->ball_count;
+    if (n < REORDER_MIN_BALLS || ++o->frames_since_check < REORDER_INTERVAL_FRAMES) return;
+    o->frames_since_check = 0;
+
+    // Everything is allocated before anything moves, so running out of
+    // scratch leaves the pool as it was.
+    size_t mark = arena_mark(w->scratch);
+    Order_Entry* order = ARENA_PUSH_ARRAY(w->scratch, Order_Entry, n);
+    int* new_index = ARENA_PUSH_ARRAY(w->scratch, int, n);
+    unsigned char* tmp = (unsigned char*)ARENA_PUSH_ARRAY(w->scratch, Ball, n);
+    Cache_Entry* contacts = ARENA_PUSH_ARRAY(w->scratch, Cache_Entry, w->ball_contacts.count + 1);
+    Manifold_Entry* manifold = ARENA_PUSH_ARRAY(w->scratch, Manifold_Entry, w->leg_contacts.count + 1);
+    if (order == NULL || new_index == NULL || tmp == NULL || contacts == NULL || manifold == NULL) {
+        arena_rewind(w->scratch, mark);
+        return;
+    }
+
+    int descents = 0;
+    for (int i = 0; i < n; i++) {
+        Vector2 p = w->balls[i].centre_position;
+        uint32_t code = morton_code(reorder_cell(p.x), reorder_cell(p.y));
+        order[i] = (Order_Entry) {code, i};
+        if (i > 0 && code < order[i - 1].code) descents++;
+    }
+    o->disorder = (float)descents / (float)(n - 1);
+    if (o->disorder <= REORDER_DISORDER) {
+        arena_rewind(w->scratch, mark);
+        return;
+    }
+
+    qsort(order, n, sizeof(Order_Entry), compare_order);
+    for (int i = 0; i < n; i++) new_index[order[i].ball] = i;
+
+    Event_Queue* q = &w->events;
+    permute(w->balls, sizeof(Ball), order, n, tmp);
+    permute(q->airborne, sizeof(bool), order, n, tmp);
+    permute(q->stamp, sizeof(uint32_t), order, n, tmp);
+    permute(q->launch_position, sizeof(Vector2), order, n, tmp);
+    permute(q->launch_velocity, sizeof(Vector2), order, n, tmp);
+    permute(q->launch_time, sizeof(double), order, n, tmp);
+    for (int k = 0; k < q->count; k++) q->heap[k].ball = new_index[q->heap[k].ball];
+    remap_contacts(&w->ball_contacts, new_index, contacts);
+    remap_manifold(&w->leg_contacts, new_index, manifold);
+    for (int s = 0; s < TRAJECTORY_CACHE_SLOTS; s++) w->trajectories.slots[s].ball = -1;
+
+    o->reorders++;
+    arena_rewind(w->scratch, mark);
+}
@@ -0,0 +1,37 @@
+#ifndef REORDER_H
+#define REORDER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "arena.h"
+
+// Keeps the ball pool in Z-order of position, so balls that touch sit close
+// in memory and the contact sweep, the impulse solver and the leg contact
+// pass walk the pool instead of jumping across it. Every
+// REORDER_INTERVAL_FRAMES the balls' Morton codes over REORDER_CELL_SIZE
+// cells are taken in pool order, and the disorder, the fraction of
+// neighbours out of code order, is measured. Past REORDER_DISORDER the pool
+// is sorted by code. Everything that keeps a
+// ball index across frames is remapped: the contact cache keys, the leg
+// manifold keys, the event queue's per-ball state and heap entries. The
+// trajectory cache is cleared.
+//
+// Characters are not reordered: hips never move, and the crowd is already
+// laid out row by row when it is built.
+
+#define REORDER_INTERVAL_FRAMES 30
+#define REORDER_DISORDER 0.15f
+#define REORDER_MIN_BALLS 64
+#define REORDER_CELL_SIZE 16.0f
+
+typedef struct ball_order {
+    int frames_since_check;
+    float disorder;
+    long long reorders;
+} Ball_Order;
+
+struct world;
+
+void reorder_balls(struct world* w);
+
+#endif
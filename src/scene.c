@@ -0,0 +1,234 @@
+#include "raylib.h"
+#include <stdio.h>
+#include <string.h>
+#include "main.h"
+#include "scene.h"
+
+static uint64_t align_up(uint64_t v)
+{
+    return (v + (SCENE_ALIGN - 1)) & ~(uint64_t)(SCENE_ALIGN - 1);
+}
+
+static void scene_layout(const World* w, Scene_Header* h, const void* arrays[SCENE_ARRAY_COUNT])
+{
+    *h = (Scene_Header) {
+        .magic = SCENE_MAGIC,
+        .version = SCENE_VERSION,
+        .header_size = sizeof(Scene_Header),
+        .record_size = {
+            [SCENE_JOINTS] = sizeof(Joint_Element),
+            [SCENE_LEGS] = sizeof(Leg_Element),
+            [SCENE_LEG_POINTS] = sizeof(Leg_Points),
+            [SCENE_LEG_RENDER] = sizeof(Leg_Render),
+            [SCENE_BALLS] = sizeof(Ball),
+            [SCENE_CHARACTERS] = sizeof(Character),
+        },
+        .record_count = {
+            [SCENE_JOINTS] = w->joint_count,
+            [SCENE_LEGS] = w->leg_count,
+            [SCENE_LEG_POINTS] = w->leg_count,
+            [SCENE_LEG_RENDER] = w->leg_count,
+            [SCENE_BALLS] = w->ball_count,
+            [SCENE_CHARACTERS] = w->character_count,
+        },
+    };
+    arrays[SCENE_JOINTS] = w->joints;
+    arrays[SCENE_LEGS] = w->legs;
+    arrays[SCENE_LEG_POINTS] = w->leg_points;
+    arrays[SCENE_LEG_RENDER] = w->leg_render;
+    arrays[SCENE_BALLS] = w->balls;
+    arrays[SCENE_CHARACTERS] = w->characters;
+
+    uint64_t at = align_up(sizeof(Scene_Header));
+    for (int i = 0; i < SCENE_ARRAY_COUNT; i++) {
+        h->offset[i] = at;
+        at = align_up(at + (uint64_t)h->record_size[i] * (uint64_t)h->record_count[i]);
+    }
+    h->file_size = at;
+}
+
+bool scene_write(const World* w, const char* path)
+{
+    Scene_Header h;
+    const void* arrays[SCENE_ARRAY_COUNT];
+    scene_layout(w, &h, arrays);
+
+    FILE* f = fopen(path, "wb");
+    if (f == NULL) return false;
+
+    static const unsigned char zeros[SCENE_ALIGN] = {0};
+    bool ok = fwrite(&h, sizeof(h), 1, f) == 1;
+    uint64_t at = sizeof(h);
+    for (int i = 0; i < SCENE_ARRAY_COUNT && ok; i++) {
+        ok = fwrite(zeros, 1, (size_t)(h.offset[i] - at), f) == (size_t)(h.offset[i] - at);
+        size_t bytes = (size_t)h.record_size[i] * (size_t)h.record_count[i];
+        ok = ok && fwrite(arrays[i], 1, bytes, f) == bytes;
+        at = h.offset[i] + bytes;
+    }
+    ok = ok && fwrite(zeros, 1, (size_t)(h.file_size - at), f) == (size_t)(h.file_size - at);
+
+    return fclose(f) == 0 && ok;
+}
+
+// Largest count of each array a scene may carry; anything over is rejected
+// before it reaches the layout maths.
+static const int64_t scene_max_count[SCENE_ARRAY_COUNT] = {
+    [SCENE_JOINTS] = (int64_t)MAX_CHARACTERS * JOINT_COUNT,
+    [SCENE_LEGS] = (int64_t)MAX_CHARACTERS * LEG_COUNT,
+    [SCENE_LEG_POINTS] = (int64_t)MAX_CHARACTERS * LEG_COUNT,
+    [SCENE_LEG_RENDER] = (int64_t)MAX_CHARACTERS * LEG_COUNT,
+    [SCENE_BALLS] = MAX_BALLS,
+    [SCENE_CHARACTERS] = MAX_CHARACTERS,
+};
+
+// Every index stored in the mapped records must land inside its array, and
+// characters must own consecutive runs of joints and legs in order.
+static bool scene_indices_valid(const World* w)
+{
+    for (int i = 0; i < w->joint_count; i++) {
+        const Joint_Element* j = &w->joints[i];
+        if (j->connects_from < -1 || j->connects_from >= w->leg_count) return false;
+        if (j->connects_to < -1 || j->connects_to >= w->leg_count) return false;
+    }
+    for (int i = 0; i < w->leg_count; i++) {
+        if (w->legs[i].origin < 0 || w->legs[i].origin >= w->joint_count) return false;
+    }
+    // joint_character and the per-character LOD lookups divide an index by
+    // JOINT_COUNT or LEG_COUNT, so characters must sit back to back in order.
+    if (w->joint_count != w->character_count * JOINT_COUNT || w->leg_count != w->character_count * LEG_COUNT) return false;
+    for (int i = 0; i < w->character_count; i++) {
+        const Character* c = &w->characters[i];
+        if (c->first_joint != i * JOINT_COUNT || c->first_leg != i * LEG_COUNT) return false;
+    }
+    return true;
+}
+
+bool scene_map(World* w, Platform_Mapping* m, Arena* scratch, const char* path)
+{
+    if (!platform_map_file(path, m)) {
+        printf("scene: could not map %s\n", path);
+        return false;
+    }
+
+    unsigned char* base = m->data;
+    Scene_Header h;
+    const void* expected_arrays[SCENE_ARRAY_COUNT];
+    const Scene_Header* file = (const Scene_Header*)base;
+    bool ok = m->size >= sizeof(Scene_Header) && file->magic == SCENE_MAGIC
+        && file->version == SCENE_VERSION && file->header_size == sizeof(Scene_Header);
+    for (int i = 0; i < SCENE_ARRAY_COUNT && ok; i++) {
+        ok = file->record_count[i] >= 0 && file->record_count[i] <= scene_max_count[i];
+    }
+    if (ok) {
+        // Rebuild the layout this build would have written for the same
+        // counts; any difference in record size or offset means the file is
+        // not ours to point into.
+        World counts = {
+            .joint_count = file->record_count[SCENE_JOINTS],
+            .leg_count = file->record_count[SCENE_LEGS],
+            .ball_count = file->record_count[SCENE_BALLS],
+            .character_count = file->record_count[SCENE_CHARACTERS],
+        };
+        scene_layout(&counts, &h, expected_arrays);
+        ok = memcmp(&h, file, sizeof(Scene_Header)) == 0 && h.file_size <= m->size
+            && counts.joint_count == counts.character_count * JOINT_COUNT
+            && counts.leg_count == counts.character_count * LEG_COUNT;
+    }
+    if (!ok) {
+        printf("scene: %s is not a version %d scene for this build\n", path, SCENE_VERSION);
+        platform_unmap_file(m);
+        return false;
+    }
+
+    *w = (World) {
+        .joints = (Joint_Element*)(base + h.offset[SCENE_JOINTS]),
+        .legs = (Leg_Element*)(base + h.offset[SCENE_LEGS]),
+        .leg_points = (Leg_Points*)(base + h.offset[SCENE_LEG_POINTS]),
+        .leg_render = (Leg_Render*)(base + h.offset[SCENE_LEG_RENDER]),
+        .balls = (Ball*)(base + h.offset[SCENE_BALLS]),
+        .characters = (Character*)(base + h.offset[SCENE_CHARACTERS]),
+        .joint_count = h.record_count[SCENE_JOINTS],
+        .leg_count = h.record_count[SCENE_LEGS],
+        .ball_count = h.record_count[SCENE_BALLS],
+        .character_count = h.record_count[SCENE_CHARACTERS],
+        .max_characters = h.record_count[SCENE_CHARACTERS],
+        .max_balls = h.record_count[SCENE_BALLS],
+        .selected_joint = -1,
+        .scratch = scratch,
+    };
+    if (!scene_indices_valid(w)) {
+        printf("scene: %s is not a version %d scene for this build\n", path, SCENE_VERSION);
+        platform_unmap_file(m);
+        return false;
+    }
+    return true;
+}
+
+bool scene_convert(const char* text_path, const char* scene_path)
+{
+    FILE* f = fopen(text_path, "r");
+    if (f == NULL) {
+        printf("scene: could not open %s\n", text_path);
+        return false;
+    }
+
+    char line[256];
+    char kind[16];
+    int characters = 0;
+    int balls = 0;
+    while (fgets(line, sizeof(line), f) != NULL) {
+        if (sscanf(line, "%15s", kind) != 1 || kind[0] == '#') continue;
+        if (strcmp(kind, "character") == 0) characters++;
+        else if (strcmp(kind, "ball") == 0) balls++;
+    }
+
+    if (characters > MAX_CHARACTERS || balls > MAX_BALLS) {
+        fclose(f);
+        printf("scene: %s has more than %d characters or %d balls\n", text_path, MAX_CHARACTERS, MAX_BALLS);
+        return false;
+    }
+
+    Arena arena;
+    Arena scratch = {0};
+    World w;
+    if (!arena_init(&arena, "convert", world_memory_size(characters, balls))
+        || !world_init(&w, &arena, &scratch, characters, balls)) {
+        fclose(f);
+        arena_release(&arena);
+        printf("scene: could not allocate %d characters\n", characters);
+        return false;
+    }
+
+    rewind(f);
+    bool ok = true;
+    int line_number = 0;
+    while (ok && fgets(line, sizeof(line), f) != NULL) {
+        line_number++;
+        if (sscanf(line, "%15s", kind) != 1 || kind[0] == '#') continue;
+
+        Vector2 p;
+        Vector2 sizes[LEG_COUNT];
+        if (strcmp(kind, "character") == 0) {
+            int n = sscanf(line, "%*s %f %f %f %f %f %f %f %f", &p.x, &p.y,
+                &sizes[0].x, &sizes[0].y, &sizes[1].x, &sizes[1].y, &sizes[2].x, &sizes[2].y);
+            ok = (n == 2 || n == 2 + 2 * LEG_COUNT);
+            if (ok) add_character(&w, p, n == 2 ? NULL : sizes);
+        } else if (strcmp(kind, "ball") == 0) {
+            ok = sscanf(line, "%*s %f %f", &p.x, &p.y) == 2;
+            if (ok) add_ball(&w, p);
+        } else {
+            ok = false;
+        }
+        if (!ok) printf("scene: %s:%d: cannot parse \"%s\"\n", text_path, line_number, kind);
+    }
+    fclose(f);
+
+    if (ok) {
+        update_joint_positions(&w);
+        ok = scene_write(&w, scene_path);
+        if (ok) printf("scene: wrote %d characters and %d balls to %s\n", w.character_count, w.ball_count, scene_path);
+        else printf("scene: could not write %s\n", scene_path);
+    }
+    arena_release(&arena);
+    return ok;
+}
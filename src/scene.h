@@ -0,0 +1,47 @@
+#ifndef SCENE_H
+#define SCENE_H
+
+#include <stdint.h>
+#include "platform.h"
+
+// Binary scene file. The header is followed by the World arrays exactly as
+// they sit in memory, each starting at a SCENE_ALIGN boundary, so loading is
+// one file mapping plus pointing the World arrays at their offsets. Record
+// sizes are stored so a file written by a build with a different layout is
+// rejected instead of misread.
+//
+// The text form converted by scene_convert has one entry per line:
+//   character <hip x> <hip y> [thigh w h  leg w h  foot w h]
+//   ball <x> <y>
+// Blank lines and lines starting with '#' are ignored.
+
+#define SCENE_MAGIC 0x4e44524du // "MRDN"
+#define SCENE_VERSION 1
+#define SCENE_ALIGN 64
+
+typedef enum scene_array {
+    SCENE_JOINTS,
+    SCENE_LEGS,
+    SCENE_LEG_POINTS,
+    SCENE_LEG_RENDER,
+    SCENE_BALLS,
+    SCENE_CHARACTERS,
+    SCENE_ARRAY_COUNT
+} Scene_Array;
+
+typedef struct scene_header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t header_size;
+    uint32_t reserved;
+    uint32_t record_size[SCENE_ARRAY_COUNT];
+    int32_t record_count[SCENE_ARRAY_COUNT];
+    uint64_t offset[SCENE_ARRAY_COUNT];
+    uint64_t file_size;
+} Scene_Header;
+
+bool scene_write(const World* w, const char* path);
+bool scene_map(World* w, Platform_Mapping* m, Arena* scratch, const char* path);
+bool scene_convert(const char* text_path, const char* scene_path);
+
+#endif
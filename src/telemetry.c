@@ -0,0 +1,103 @@
+#include "raylib.h"
+#include "raymath.h"
+#include <stdio.h>
+#include <string.h>
+#include "main.h"
+#include "telemetry.h"
+
+Telemetry telemetry;
+
+// Writer half of the seqlock. The odd store must be visible before any of
+// the frame's stores, and the frame's stores before the even one.
+static void write_begin(Telemetry_Segment* s)
+{
+    __atomic_store_n(&s->sequence, s->sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static void write_end(Telemetry_Segment* s)
+{
+    __atomic_store_n(&s->sequence, s->sequence + 1, __ATOMIC_RELEASE);
+}
+
+bool telemetry_open(void)
+{
+    Telemetry* t = &telemetry;
+    *t = (Telemetry) {0};
+    if (!platform_create_shared(TELEMETRY_NAME, sizeof(Telemetry_Segment), &t->mapping)) {
+        printf("telemetry: could not create shared memory %s\n", TELEMETRY_NAME);
+        return false;
+    }
+    Telemetry_Segment* s = t->mapping.data;
+    memset(s, 0, sizeof(*s));
+    s->version = TELEMETRY_VERSION;
+    s->size = sizeof(Telemetry_Segment);
+    s->zone_count = PROF_ZONE_COUNT;
+    for (int i = 0; i < PROF_ZONE_COUNT; i++) {
+        snprintf(s->zone_names[i], TELEMETRY_ZONE_NAME_SIZE, "%s", prof_zone_names[i]);
+    }
+    hist_reset(&s->frame.frame_ns);
+    // Readers check magic last, once everything above is in place.
+    __atomic_store_n(&s->magic, TELEMETRY_MAGIC, __ATOMIC_RELEASE);
+    t->segment = s;
+    t->last_publish_ns = platform_now_ns();
+    printf("telemetry: publishing to %s\n", TELEMETRY_NAME);
+    return true;
+}
+
+// A reload starts the solver counters over; the totals carry on from there.
+static uint64_t counter_delta(uint64_t now, uint64_t* last)
+{
+    uint64_t d = now >= *last ? now - *last : now;
+    *last = now;
+    return d;
+}
+
+void telemetry_publish(const World* w)
+{
+    Telemetry* t = &telemetry;
+    Telemetry_Segment* s = t->segment;
+    if (s == NULL) return;
+
+    uint64_t now = platform_now_ns();
+    int awake = 0;
+    for (int i = 0; i < w->ball_count; i++) {
+        if (!w->events.airborne[i] && Vector2LengthSqr(w->balls[i].velocity) > IDLE_REST_SPEED * IDLE_REST_SPEED) awake++;
+    }
+    uint64_t solves = counter_delta(w->xpbd.ik_solves, &t->last_ik_solves);
+    uint64_t iterations = counter_delta(w->xpbd.ik_iterations, &t->last_ik_iterations);
+
+    write_begin(s);
+    Telemetry_Frame* f = &s->frame;
+    f->frame++;
+    f->time_ns = now;
+    for (int i = 0; i < PROF_ZONE_COUNT; i++) {
+        f->zone_ns[i] = (uint64_t)(prof_ticks_to_ms(prof_last_frame_ticks(i)) * 1e6);
+    }
+    f->ik_solves_total += solves;
+    f->ik_iterations_total += iterations;
+    f->characters = w->character_count;
+    f->animated_characters = w->anim.active_count;
+    f->driven_characters = w->xpbd.frame_driven;
+    for (int i = 0; i < LOD_TIER_COUNT; i++) f->lod_tier_count[i] = w->lod.tier_count[i];
+    f->balls = w->ball_count;
+    f->awake_balls = awake;
+    f->airborne_balls = w->events.airborne_count;
+    f->ball_contacts = w->ball_contacts.count;
+    f->leg_contacts = w->leg_contacts.count;
+    hist_record(&f->frame_ns, now - t->last_publish_ns);
+    write_end(s);
+    t->last_publish_ns = now;
+}
+
+void telemetry_close(void)
+{
+    Telemetry* t = &telemetry;
+    if (t->segment == NULL) return;
+    write_begin(t->segment);
+    t->segment->frame.closed = 1;
+    write_end(t->segment);
+    platform_unmap_file(&t->mapping);
+    platform_unlink_shared(TELEMETRY_NAME);
+    *t = (Telemetry) {0};
+}
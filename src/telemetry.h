@@ -0,0 +1,91 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "platform.h"
+#include "histogram.h"
+#include "profiler.h"
+#include "lod.h"
+
+// Live telemetry for a running sim in a named shared-memory segment, for
+// tools/telemetry_view or anything else that maps it. telemetry_publish
+// writes the frame's numbers in place once per frame under a seqlock:
+// sequence is odd while a write is in progress, and a reader copies the
+// frame and retries if sequence was odd or moved meanwhile. Neither side
+// ever waits on the other, so a reader at any rate costs the sim nothing.
+//
+// Counters ending in _total run from the start of the process, so readers
+// sampling at any rate take differences. zone_ns is the last frame's
+// profiler zones and stays zero in a PROFILE=0 build; frame_ns records
+// the time between publishes whatever the build.
+
+#define TELEMETRY_NAME "maradonna_telemetry"
+#define TELEMETRY_MAGIC 0x4c544d4du
+#define TELEMETRY_VERSION 1
+#define TELEMETRY_ZONE_NAME_SIZE 32
+#define TELEMETRY_READ_RETRIES 1000
+
+typedef struct telemetry_frame {
+    uint64_t frame;
+    uint64_t time_ns;
+    uint64_t zone_ns[PROF_ZONE_COUNT];
+    uint64_t ik_solves_total;
+    uint64_t ik_iterations_total;
+    int32_t characters;
+    int32_t animated_characters;
+    int32_t driven_characters;
+    int32_t lod_tier_count[LOD_TIER_COUNT];
+    int32_t balls;
+    int32_t awake_balls;
+    int32_t airborne_balls;
+    int32_t ball_contacts;
+    int32_t leg_contacts;
+    uint32_t closed;
+    Histogram frame_ns;
+} Telemetry_Frame;
+
+typedef struct telemetry_segment {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t size;
+    uint32_t zone_count;
+    char zone_names[PROF_ZONE_COUNT][TELEMETRY_ZONE_NAME_SIZE];
+    uint32_t sequence;
+    Telemetry_Frame frame;
+} Telemetry_Segment;
+
+typedef struct telemetry {
+    Platform_Mapping mapping;
+    Telemetry_Segment* segment;
+    uint64_t last_publish_ns;
+    uint64_t last_ik_solves;
+    uint64_t last_ik_iterations;
+} Telemetry;
+
+struct world;
+
+// Empty until telemetry_open; publishing to it is then a no-op.
+extern Telemetry telemetry;
+
+bool telemetry_open(void);
+void telemetry_publish(const struct world* w);
+void telemetry_close(void);
+
+// Copies a consistent frame out of a segment someone else is writing.
+// Returns false if no consistent copy was seen in TELEMETRY_READ_RETRIES.
+// Inline so a reader needs nothing but this header.
+static inline bool telemetry_read(const Telemetry_Segment* s, Telemetry_Frame* out)
+{
+    for (int i = 0; i < TELEMETRY_READ_RETRIES; i++) {
+        uint32_t before = __atomic_load_n(&s->sequence, __ATOMIC_ACQUIRE);
+        if (before & 1u) continue;
+        memcpy(out, (const void*)&s->frame, sizeof(*out));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&s->sequence, __ATOMIC_RELAXED) == before) return true;
+    }
+    return false;
+}
+
+#endif
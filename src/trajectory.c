@@ -0,0 +1,202 @@
+#include "raylib.h"
+#include "raymath.h"
+#include <math.h>
+#include "main.h"
+#include "trajectory.h"
+
+// Spans of t in [0, t_max] during which one coordinate of the arc lies in
+// [lo, hi]; at most two for a quadratic.
+typedef struct time_spans {
+    float start[2];
+    float end[2];
+    int count;
+} Time_Spans;
+
+size_t trajectory_memory_size(void)
+{
+    return TRAJECTORY_CACHE_SLOTS * sizeof(Trajectory_Slot) + 16;
+}
+
+bool trajectory_init(Trajectory_Cache* c, Arena* level)
+{
+    *c = (Trajectory_Cache) {0};
+    c->slots = ARENA_PUSH_ARRAY(level, Trajectory_Slot, TRAJECTORY_CACHE_SLOTS);
+    if (c->slots == NULL) return false;
+    for (int i = 0; i < TRAJECTORY_CACHE_SLOTS; i++) c->slots[i].ball = -1;
+    return true;
+}
+
+// Roots of c0 + c1 t + c2 t^2 = 0, written to roots; returns how many.
+static int quadratic_roots(float c0, float c1, float c2, float roots[2])
+{
+    if (c2 == 0.0f) {
+        if (c1 == 0.0f) return 0;
+        roots[0] = -c0 / c1;
+        return 1;
+    }
+    float disc = c1 * c1 - 4.0f * c2 * c0;
+    if (disc < 0.0f) return 0;
+    // The larger-magnitude root first, the other from the product of roots,
+    // so neither loses precision when c2 is small.
+    float q = -0.5f * (c1 + copysignf(sqrtf(disc), c1));
+    if (q == 0.0f) {
+        roots[0] = 0.0f;
+        return 1;
+    }
+    roots[0] = q / c2;
+    roots[1] = c0 / q;
+    return 2;
+}
+
+// Cuts [0, t_max] at every time the coordinate crosses lo or hi and keeps
+// the pieces whose middle lies inside the band.
+static Time_Spans band_spans(float c0, float c1, float c2, float lo, float hi, float t_max)
+{
+    float cuts[6] = {0.0f};
+    int n = 1;
+    float roots[2];
+    int k = quadratic_roots(c0 - lo, c1, c2, roots);
+    for (int i = 0; i < k; i++) if (roots[i] > 0.0f && roots[i] < t_max) cuts[n++] = roots[i];
+    k = quadratic_roots(c0 - hi, c1, c2, roots);
+    for (int i = 0; i < k; i++) if (roots[i] > 0.0f && roots[i] < t_max) cuts[n++] = roots[i];
+    cuts[n++] = t_max;
+    for (int i = 1; i < n; i++) {
+        for (int j = i; j > 0 && cuts[j] < cuts[j - 1]; j--) {
+            float t = cuts[j];
+            cuts[j] = cuts[j - 1];
+            cuts[j - 1] = t;
+        }
+    }
+
+    Time_Spans s = {0};
+    for (int i = 0; i + 1 < n; i++) {
+        float mid = 0.5f * (cuts[i] + cuts[i + 1]);
+        float c = c0 + (c1 + c2 * mid) * mid;
+        if (c < lo || c > hi) continue;
+        if (s.count > 0 && s.end[s.count - 1] == cuts[i]) s.end[s.count - 1] = cuts[i + 1];
+        else if (s.count < 2) {
+            s.start[s.count] = cuts[i];
+            s.end[s.count++] = cuts[i + 1];
+        }
+    }
+    return s;
+}
+
+// First time both coordinates are inside their bands, or INFINITY.
+static float first_overlap(const Time_Spans* a, const Time_Spans* b)
+{
+    float t = INFINITY;
+    for (int i = 0; i < a->count; i++) {
+        for (int j = 0; j < b->count; j++) {
+            float start = fmaxf(a->start[i], b->start[j]);
+            if (start <= fminf(a->end[i], b->end[j])) t = fminf(t, start);
+        }
+    }
+    return t;
+}
+
+// First time within t_max that a ball of radius r on the arc touches the
+// rectangle [0, width] x [0, height] spanned by axes u and v from origin.
+static float rect_entry(Vector2 p, Vector2 v, float g, float r, Vector2 origin, Vector2 u, Vector2 w,
+    float width, float height, float t_max)
+{
+    Vector2 d = Vector2Subtract(p, origin);
+    Time_Spans su = band_spans(Vector2DotProduct(d, u), Vector2DotProduct(v, u), 0.5f * g * u.y,
+        -r, width + r, t_max);
+    if (su.count == 0) return INFINITY;
+    Time_Spans sv = band_spans(Vector2DotProduct(d, w), Vector2DotProduct(v, w), 0.5f * g * w.y,
+        -r, height + r, t_max);
+    return first_overlap(&su, &sv);
+}
+
+static Trajectory predict(World* w, const Ball* b, float g)
+{
+    Vector2 p = b->centre_position, v = b->velocity;
+    float r = b->radius;
+    Trajectory path = {.end = TRAJECTORY_HORIZON, .leg = -1};
+    float t = TRAJECTORY_HORIZON_FRAMES;
+
+    // Floor: the first positive root of p.y + v.y t + g t^2 / 2 = BALL_FLOOR_Y - r.
+    float floor_y = BALL_FLOOR_Y - r;
+    float t_floor = p.y >= floor_y ? 0.0f : INFINITY;
+    float roots[2];
+    int n = p.y >= floor_y ? 0 : quadratic_roots(p.y - floor_y, v.y, 0.5f * g, roots);
+    for (int k = 0; k < n; k++) if (roots[k] > 0.0f) t_floor = fminf(t_floor, roots[k]);
+    if (t_floor < t) {
+        t = t_floor;
+        path.end = TRAJECTORY_FLOOR;
+    }
+    float t_wall = INFINITY;
+    if (p.x - r <= 0.0f || p.x + r >= WIDTH) t_wall = 0.0f;
+    else if (v.x < 0.0f) t_wall = (p.x - r) / -v.x;
+    else if (v.x > 0.0f) t_wall = (WIDTH - r - p.x) / v.x;
+    if (t_wall < t) {
+        t = t_wall;
+        path.end = TRAJECTORY_WALL;
+    }
+
+    const Vector2 x_axis = {1.0f, 0.0f}, y_axis = {0.0f, 1.0f};
+    for (int c = 0; c < w->character_count && t > 0.0f; c++) {
+        const Character* ch = &w->characters[c];
+        Vector2 hip = w->joints[ch->first_joint].centre_position;
+        float reach = 0.0f;
+        for (int k = 0; k < LEG_COUNT; k++) {
+            const Leg_Element* l = &w->legs[ch->first_leg + k];
+            reach += Vector2Length((Vector2) {l->shape.width, l->shape.height});
+        }
+        Vector2 corner = {hip.x - reach, hip.y - reach};
+        if (rect_entry(p, v, g, r, corner, x_axis, y_axis, 2.0f * reach, 2.0f * reach, t) >= t) continue;
+
+        for (int k = 0; k < LEG_COUNT; k++) {
+            int i = ch->first_leg + k;
+            const Leg_Element* l = &w->legs[i];
+            const Leg_Points* lp = &w->leg_points[i];
+            if (l->shape.width <= 0.0f || l->shape.height <= 0.0f) continue;
+            Vector2 u = Vector2Scale(Vector2Subtract(lp->top_left, lp->top_right), 1.0f / l->shape.width);
+            Vector2 vv = Vector2Scale(Vector2Subtract(lp->bot_right, lp->top_right), 1.0f / l->shape.height);
+            float t_leg = rect_entry(p, v, g, r, lp->top_right, u, vv, l->shape.width, l->shape.height, t);
+            if (t_leg < t) {
+                t = t_leg;
+                path.end = TRAJECTORY_LEG;
+                path.leg = i;
+            }
+        }
+    }
+
+    path.time = t;
+    path.velocity = (Vector2) {v.x, v.y + g * t};
+    path.count = t > 0.0f ? TRAJECTORY_POINTS : 1;
+    for (int k = 0; k < path.count; k++) {
+        float s = path.count > 1 ? t * (float)k / (float)(path.count - 1) : 0.0f;
+        path.points[k] = (Vector2) {p.x + v.x * s, p.y + v.y * s + 0.5f * g * s * s};
+    }
+    return path;
+}
+
+static bool same_key(const Trajectory_Key* a, const Trajectory_Key* b)
+{
+    return a->position.x == b->position.x && a->position.y == b->position.y
+        && a->velocity.x == b->velocity.x && a->velocity.y == b->velocity.y
+        && a->radius == b->radius && a->pose_version == b->pose_version;
+}
+
+// The predicted path of ball from its current state, with its per-frame
+// velocity and gravity taken at TRAJECTORY_DT. The result stays valid until
+// the next query that misses the same slot.
+const Trajectory* trajectory_predict(World* w, int ball)
+{
+    if (ball < 0 || ball >= w->ball_count) return NULL;
+    Trajectory_Cache* c = &w->trajectories;
+    const Ball* b = &w->balls[ball];
+    Trajectory_Slot* slot = &c->slots[ball % TRAJECTORY_CACHE_SLOTS];
+    Trajectory_Key key = {b->centre_position, b->velocity, b->radius, w->pose_version};
+    if (slot->ball == ball && same_key(&slot->key, &key)) {
+        c->hits++;
+        return &slot->path;
+    }
+    c->misses++;
+    slot->ball = ball;
+    slot->key = key;
+    slot->path = predict(w, b, GRAVITY * TRAJECTORY_DT);
+    return &slot->path;
+}
@@ -0,0 +1,72 @@
+#ifndef TRAJECTORY_H
+#define TRAJECTORY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "arena.h"
+
+// Predicted ball paths for kick aiming. The arc is solved in closed form
+// from the ball's state, p(t) = p + v t + 1/2 g t^2 in frames, and cut at
+// its first contact with the floor, a side wall or a leg in its current
+// pose. Each leg is tested in its own frame, where the rectangle grown by
+// the ball radius is axis-aligned and both coordinates of the arc are
+// quadratics in t; the grown corners are square, so a ball passing a corner
+// may be reported touching up to 0.4 radius early. Characters whose reach
+// box the arc never enters are skipped with one test.
+//
+// The arc is always taken at the nominal TRAJECTORY_DT frame rather than
+// the measured frame time, whose jitter would change every prediction.
+// Results are cached in TRAJECTORY_CACHE_SLOTS slots, picked by ball index,
+// and stay valid until the ball's state or the world's pose_version
+// changes, so a ball at rest under a still crowd is predicted once.
+
+#define TRAJECTORY_POINTS 32
+#define TRAJECTORY_HORIZON_FRAMES 180.0f
+#define TRAJECTORY_CACHE_SLOTS 16
+#define TRAJECTORY_DT (1.0f / 60.0f)
+
+typedef enum trajectory_end {
+    TRAJECTORY_HORIZON,
+    TRAJECTORY_FLOOR,
+    TRAJECTORY_WALL,
+    TRAJECTORY_LEG,
+} Trajectory_End;
+
+// points[0] is the ball's position, points[count - 1] the contact point;
+// they are spaced evenly in time. leg is -1 unless end is TRAJECTORY_LEG.
+typedef struct trajectory {
+    Vector2 points[TRAJECTORY_POINTS];
+    int count;
+    float time;
+    Vector2 velocity;
+    Trajectory_End end;
+    int leg;
+} Trajectory;
+
+// Everything a cached path depends on.
+typedef struct trajectory_key {
+    Vector2 position;
+    Vector2 velocity;
+    float radius;
+    uint32_t pose_version;
+} Trajectory_Key;
+
+typedef struct trajectory_slot {
+    int ball;
+    Trajectory_Key key;
+    Trajectory path;
+} Trajectory_Slot;
+
+typedef struct trajectory_cache {
+    Trajectory_Slot* slots;
+    long long hits;
+    long long misses;
+} Trajectory_Cache;
+
+struct world;
+
+size_t trajectory_memory_size(void);
+bool trajectory_init(Trajectory_Cache* c, Arena* level);
+const Trajectory* trajectory_predict(struct world* w, int ball);
+
+#endif
@@ -0,0 +1,662 @@
+#include "raylib.h"
+#include "raymath.h"
+#include <string.h>
+#include <math.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#include "main.h"
+#include "dispatch.h"
+#if defined(DISPATCH_AVX2)
+#include <immintrin.h>
+#endif
+#include "xpbd.h"
+
+#define PARTICLES_PER_CHARACTER (JOINT_COUNT + 1)
+#define CONSTRAINTS_PER_CHARACTER ((JOINT_COUNT - 1) + (JOINT_COUNT - 2) + 1)
+
+typedef struct particles {
+    float* x;
+    float* y;
+    float* inv_mass;
+} Particles;
+
+typedef struct constraints {
+    int32_t* a;
+    int32_t* b;
+    float* rest;
+    float* compliance;
+    float* lambda;
+    int32_t* iterations;
+    int32_t* kind;
+    uint8_t* color;
+    int count;
+} Constraints;
+
+typedef struct leg_contacts {
+    uint64_t* key;
+    int32_t* ball;
+    Vector2* point;
+    Vector2* normal;
+    float* impulse;
+    int count;
+} Leg_Contacts;
+
+// Unit axes of a leg box: u along the width, v along the height, both from
+// the top-right corner.
+typedef struct leg_frame {
+    Vector2 origin;
+    Vector2 u;
+    Vector2 v;
+} Leg_Frame;
+
+size_t xpbd_memory_size(int character_count)
+{
+    return (size_t)character_count * (2 * sizeof(int) + sizeof(Vector2) + sizeof(uint32_t)) + 4 * 16;
+}
+
+bool xpbd_init(Xpbd_Solver* s, Arena* level, int character_count)
+{
+    *s = (Xpbd_Solver) {.max_driven = character_count};
+    s->driven = ARENA_PUSH_ARRAY(level, int, character_count);
+    s->target = ARENA_PUSH_ARRAY(level, Vector2, character_count);
+    s->iterations = ARENA_PUSH_ARRAY(level, int, character_count);
+    s->driven_frame = ARENA_PUSH_ARRAY(level, uint32_t, character_count);
+    if (s->driven == NULL || s->target == NULL || s->iterations == NULL || s->driven_frame == NULL) return false;
+    memset(s->driven_frame, 0, sizeof(uint32_t) * (size_t)character_count);
+    s->frame = 1;
+    return true;
+}
+
+void xpbd_begin_frame(Xpbd_Solver* s)
+{
+    s->frame++;
+    s->frame_driven = 0;
+}
+
+size_t leg_manifold_memory_size(int max_balls)
+{
+    return (size_t)max_balls * XPBD_MAX_LEG_CONTACTS * (sizeof(uint64_t) + 2 * sizeof(Vector2) + sizeof(float)) + 4 * 16;
+}
+
+bool leg_manifold_init(Leg_Manifold* m, Arena* level, int max_balls)
+{
+    int capacity = max_balls * XPBD_MAX_LEG_CONTACTS;
+    *m = (Leg_Manifold) {.capacity = capacity};
+    m->key = ARENA_PUSH_ARRAY(level, uint64_t, capacity);
+    m->point = ARENA_PUSH_ARRAY(level, Vector2, capacity);
+    m->normal = ARENA_PUSH_ARRAY(level, Vector2, capacity);
+    m->impulse = ARENA_PUSH_ARRAY(level, float, capacity);
+    return m->key != NULL && m->point != NULL && m->normal != NULL && m->impulse != NULL;
+}
+
+void xpbd_drive(World* w, int character, Vector2 target, int iterations)
+{
+    Xpbd_Solver* s = &w->xpbd;
+    if (s->driven_count >= s->max_driven || iterations <= 0) return;
+    s->driven[s->driven_count] = character;
+    s->target[s->driven_count] = target;
+    s->iterations[s->driven_count] = iterations;
+    s->driven_count++;
+    // Substeps drive the same characters again; count each once a frame.
+    if (s->driven_frame[character] != s->frame) {
+        s->driven_frame[character] = s->frame;
+        s->frame_driven++;
+    }
+}
+
+static bool push_constraints(Arena* a, Constraints* c, int capacity)
+{
+    *c = (Constraints) {0};
+    c->a = ARENA_PUSH_ARRAY(a, int32_t, capacity);
+    c->b = ARENA_PUSH_ARRAY(a, int32_t, capacity);
+    c->rest = ARENA_PUSH_ARRAY(a, float, capacity);
+    c->compliance = ARENA_PUSH_ARRAY(a, float, capacity);
+    c->lambda = ARENA_PUSH_ARRAY(a, float, capacity);
+    c->iterations = ARENA_PUSH_ARRAY(a, int32_t, capacity);
+    c->kind = ARENA_PUSH_ARRAY(a, int32_t, capacity);
+    c->color = ARENA_PUSH_ARRAY(a, uint8_t, capacity);
+    return c->a != NULL && c->b != NULL && c->rest != NULL && c->compliance != NULL
+        && c->lambda != NULL && c->iterations != NULL && c->kind != NULL && c->color != NULL;
+}
+
+static void add_constraint(Constraints* c, int a, int b, float rest, float compliance, int iterations, Xpbd_Kind kind)
+{
+    int i = c->count++;
+    c->a[i] = a;
+    c->b[i] = b;
+    c->rest[i] = rest;
+    c->compliance[i] = compliance;
+    c->lambda[i] = 0.0f;
+    c->iterations[i] = iterations;
+    c->kind[i] = kind;
+}
+
+// Greedy colouring: each constraint takes the lowest colour that neither of
+// its movable particles has used yet. Static particles never move, so they
+// never conflict. Returns the number of colours used.
+static int color_constraints(Constraints* c, const Particles* p, uint32_t* used, int particle_count, int* color_count)
+{
+    for (int i = 0; i < particle_count; i++) used[i] = 0;
+    for (int i = 0; i < XPBD_MAX_COLORS; i++) color_count[i] = 0;
+    int colors = 0;
+    for (int i = 0; i < c->count; i++) {
+        int a = c->a[i], b = c->b[i];
+        uint32_t busy = (p->inv_mass[a] > 0.0f ? used[a] : 0) | (p->inv_mass[b] > 0.0f ? used[b] : 0);
+        int color = __builtin_ctz(~busy | (1u << (XPBD_MAX_COLORS - 1)));
+        // The last colour is projected serially, so it may hold conflicts.
+        if (color < XPBD_MAX_COLORS - 1) {
+            used[a] |= 1u << color;
+            used[b] |= 1u << color;
+        }
+        c->color[i] = (uint8_t)color;
+        color_count[color]++;
+        if (color + 1 > colors) colors = color + 1;
+    }
+    return colors;
+}
+
+// Stable counting sort of src into dst by colour; start gets the first index
+// of every colour plus one past the end.
+static void sort_by_color(const Constraints* src, Constraints* dst, const int* color_count, int* start)
+{
+    start[0] = 0;
+    for (int k = 0; k < XPBD_MAX_COLORS; k++) start[k + 1] = start[k] + color_count[k];
+    int next[XPBD_MAX_COLORS];
+    for (int k = 0; k < XPBD_MAX_COLORS; k++) next[k] = start[k];
+    for (int i = 0; i < src->count; i++) {
+        int j = next[src->color[i]]++;
+        dst->a[j] = src->a[i];
+        dst->b[j] = src->b[i];
+        dst->rest[j] = src->rest[i];
+        dst->compliance[j] = src->compliance[i];
+        dst->lambda[j] = 0.0f;
+        dst->iterations[j] = src->iterations[i];
+        dst->kind[j] = src->kind[i];
+    }
+    dst->count = src->count;
+}
+
+static void project_distance(Particles* p, Constraints* c, int i, int iteration, float inv_h2)
+{
+    if (iteration >= c->iterations[i]) return;
+    int a = c->a[i], b = c->b[i];
+    float dx = p->x[a] - p->x[b];
+    float dy = p->y[a] - p->y[b];
+    float d = sqrtf(dx * dx + dy * dy);
+    if (d < 1e-6f) return;
+    float C = d - c->rest[i];
+    if (c->kind[i] == XPBD_MIN && C >= 0.0f) return;
+
+    float wa = p->inv_mass[a], wb = p->inv_mass[b];
+    float alpha = c->compliance[i] * inv_h2;
+    float denom = wa + wb + alpha;
+    if (denom <= 0.0f) return;
+    float dl = (-C - alpha * c->lambda[i]) / denom;
+    c->lambda[i] += dl;
+    float nx = dx / d, ny = dy / d;
+    p->x[a] += wa * dl * nx;
+    p->y[a] += wa * dl * ny;
+    p->x[b] -= wb * dl * nx;
+    p->y[b] -= wb * dl * ny;
+}
+
+// Projects one colour. Constraints in it share no movable particle, so they
+// can be gathered, solved and scattered four or eight at a time.
+static void project_color_scalar(Particles* p, Constraints* c, int begin, int end, int iteration, float inv_h2)
+{
+    for (int i = begin; i < end; i++) project_distance(p, c, i, iteration, inv_h2);
+}
+
+#if defined(__SSE2__)
+static void project_color_sse2(Particles* p, Constraints* c, int begin, int end, int iteration, float inv_h2)
+{
+    int i = begin;
+    const __m128i vk = _mm_set1_epi32(iteration);
+    const __m128i vmin = _mm_set1_epi32(XPBD_MIN);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 eps = _mm_set1_ps(1e-6f);
+    const __m128 vinv_h2 = _mm_set1_ps(inv_h2);
+    for (; i + 4 <= end; i += 4) {
+        const int32_t* ia = &c->a[i];
+        const int32_t* ib = &c->b[i];
+        __m128 xa = _mm_setr_ps(p->x[ia[0]], p->x[ia[1]], p->x[ia[2]], p->x[ia[3]]);
+        __m128 ya = _mm_setr_ps(p->y[ia[0]], p->y[ia[1]], p->y[ia[2]], p->y[ia[3]]);
+        __m128 xb = _mm_setr_ps(p->x[ib[0]], p->x[ib[1]], p->x[ib[2]], p->x[ib[3]]);
+        __m128 yb = _mm_setr_ps(p->y[ib[0]], p->y[ib[1]], p->y[ib[2]], p->y[ib[3]]);
+        __m128 wa = _mm_setr_ps(p->inv_mass[ia[0]], p->inv_mass[ia[1]], p->inv_mass[ia[2]], p->inv_mass[ia[3]]);
+        __m128 wb = _mm_setr_ps(p->inv_mass[ib[0]], p->inv_mass[ib[1]], p->inv_mass[ib[2]], p->inv_mass[ib[3]]);
+
+        __m128 dx = _mm_sub_ps(xa, xb);
+        __m128 dy = _mm_sub_ps(ya, yb);
+        __m128 d = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)));
+        __m128 C = _mm_sub_ps(d, _mm_loadu_ps(&c->rest[i]));
+        __m128 alpha = _mm_mul_ps(_mm_loadu_ps(&c->compliance[i]), vinv_h2);
+        __m128 denom = _mm_add_ps(_mm_add_ps(wa, wb), alpha);
+        __m128 lambda = _mm_loadu_ps(&c->lambda[i]);
+
+        // Lanes that are done iterating, degenerate, or an inequality that holds.
+        __m128i iters = _mm_loadu_si128((const __m128i*)&c->iterations[i]);
+        __m128i is_min = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i*)&c->kind[i]), vmin);
+        __m128 active = _mm_castsi128_ps(_mm_cmpgt_epi32(iters, vk));
+        active = _mm_and_ps(active, _mm_cmpgt_ps(d, eps));
+        active = _mm_and_ps(active, _mm_cmpgt_ps(denom, zero));
+        active = _mm_andnot_ps(_mm_and_ps(_mm_castsi128_ps(is_min), _mm_cmpge_ps(C, zero)), active);
+
+        __m128 safe_denom = _mm_or_ps(_mm_and_ps(active, denom), _mm_andnot_ps(active, _mm_set1_ps(1.0f)));
+        __m128 safe_d = _mm_or_ps(_mm_and_ps(active, d), _mm_andnot_ps(active, _mm_set1_ps(1.0f)));
+        __m128 dl = _mm_div_ps(_mm_sub_ps(_mm_sub_ps(zero, C), _mm_mul_ps(alpha, lambda)), safe_denom);
+        dl = _mm_and_ps(active, dl);
+        _mm_storeu_ps(&c->lambda[i], _mm_add_ps(lambda, dl));
+
+        __m128 nx = _mm_div_ps(dx, safe_d);
+        __m128 ny = _mm_div_ps(dy, safe_d);
+        float out_xa[4], out_ya[4], out_xb[4], out_yb[4];
+        _mm_storeu_ps(out_xa, _mm_add_ps(xa, _mm_mul_ps(_mm_mul_ps(wa, dl), nx)));
+        _mm_storeu_ps(out_ya, _mm_add_ps(ya, _mm_mul_ps(_mm_mul_ps(wa, dl), ny)));
+        _mm_storeu_ps(out_xb, _mm_sub_ps(xb, _mm_mul_ps(_mm_mul_ps(wb, dl), nx)));
+        _mm_storeu_ps(out_yb, _mm_sub_ps(yb, _mm_mul_ps(_mm_mul_ps(wb, dl), ny)));
+        for (int k = 0; k < 4; k++) {
+            p->x[ia[k]] = out_xa[k];
+            p->y[ia[k]] = out_ya[k];
+            p->x[ib[k]] = out_xb[k];
+            p->y[ib[k]] = out_yb[k];
+        }
+    }
+    project_color_scalar(p, c, i, end, iteration, inv_h2);
+}
+#else
+#define project_color_sse2 NULL
+#endif
+
+#if defined(DISPATCH_AVX2)
+static TARGET_AVX2 void project_color_avx2(Particles* p, Constraints* c, int begin, int end, int iteration, float inv_h2)
+{
+    int i = begin;
+    const __m256i vk = _mm256_set1_epi32(iteration);
+    const __m256i vmin = _mm256_set1_epi32(XPBD_MIN);
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 eps = _mm256_set1_ps(1e-6f);
+    const __m256 vinv_h2 = _mm256_set1_ps(inv_h2);
+    for (; i + 8 <= end; i += 8) {
+        const int32_t* ia = &c->a[i];
+        const int32_t* ib = &c->b[i];
+        __m256i va = _mm256_loadu_si256((const __m256i*)ia);
+        __m256i vb = _mm256_loadu_si256((const __m256i*)ib);
+        __m256 xa = _mm256_i32gather_ps(p->x, va, 4);
+        __m256 ya = _mm256_i32gather_ps(p->y, va, 4);
+        __m256 xb = _mm256_i32gather_ps(p->x, vb, 4);
+        __m256 yb = _mm256_i32gather_ps(p->y, vb, 4);
+        __m256 wa = _mm256_i32gather_ps(p->inv_mass, va, 4);
+        __m256 wb = _mm256_i32gather_ps(p->inv_mass, vb, 4);
+
+        __m256 dx = _mm256_sub_ps(xa, xb);
+        __m256 dy = _mm256_sub_ps(ya, yb);
+        __m256 d = _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)));
+        __m256 C = _mm256_sub_ps(d, _mm256_loadu_ps(&c->rest[i]));
+        __m256 alpha = _mm256_mul_ps(_mm256_loadu_ps(&c->compliance[i]), vinv_h2);
+        __m256 denom = _mm256_add_ps(_mm256_add_ps(wa, wb), alpha);
+        __m256 lambda = _mm256_loadu_ps(&c->lambda[i]);
+
+        __m256i iters = _mm256_loadu_si256((const __m256i*)&c->iterations[i]);
+        __m256i is_min = _mm256_cmpeq_epi32(_mm256_loadu_si256((const __m256i*)&c->kind[i]), vmin);
+        __m256 active = _mm256_castsi256_ps(_mm256_cmpgt_epi32(iters, vk));
+        active = _mm256_and_ps(active, _mm256_cmp_ps(d, eps, _CMP_GT_OQ));
+        active = _mm256_and_ps(active, _mm256_cmp_ps(denom, zero, _CMP_GT_OQ));
+        active = _mm256_andnot_ps(_mm256_and_ps(_mm256_castsi256_ps(is_min), _mm256_cmp_ps(C, zero, _CMP_GE_OQ)), active);
+
+        __m256 safe_denom = _mm256_blendv_ps(one, denom, active);
+        __m256 safe_d = _mm256_blendv_ps(one, d, active);
+        __m256 dl = _mm256_div_ps(_mm256_sub_ps(_mm256_sub_ps(zero, C), _mm256_mul_ps(alpha, lambda)), safe_denom);
+        dl = _mm256_and_ps(active, dl);
+        _mm256_storeu_ps(&c->lambda[i], _mm256_add_ps(lambda, dl));
+
+        __m256 nx = _mm256_div_ps(dx, safe_d);
+        __m256 ny = _mm256_div_ps(dy, safe_d);
+        float out_xa[8], out_ya[8], out_xb[8], out_yb[8];
+        _mm256_storeu_ps(out_xa, _mm256_add_ps(xa, _mm256_mul_ps(_mm256_mul_ps(wa, dl), nx)));
+        _mm256_storeu_ps(out_ya, _mm256_add_ps(ya, _mm256_mul_ps(_mm256_mul_ps(wa, dl), ny)));
+        _mm256_storeu_ps(out_xb, _mm256_sub_ps(xb, _mm256_mul_ps(_mm256_mul_ps(wb, dl), nx)));
+        _mm256_storeu_ps(out_yb, _mm256_sub_ps(yb, _mm256_mul_ps(_mm256_mul_ps(wb, dl), ny)));
+        for (int k = 0; k < 8; k++) {
+            p->x[ia[k]] = out_xa[k];
+            p->y[ia[k]] = out_ya[k];
+            p->x[ib[k]] = out_xb[k];
+            p->y[ib[k]] = out_yb[k];
+        }
+    }
+    project_color_scalar(p, c, i, end, iteration, inv_h2);
+}
+#else
+#define project_color_avx2 NULL
+#endif
+
+Project_Kernel* const xpbd_project_kernels[CPU_LEVEL_COUNT] = {
+    project_color_scalar, project_color_sse2, project_color_avx2,
+};
+
+static float check_random(uint32_t* s)
+{
+    *s = *s * 1664525u + 1013904223u;
+    return (float)(*s >> 8) / 16777216.0f;
+}
+
+// Projects one randomized colour with k and with the scalar reference, and
+// returns the largest difference in positions and multipliers.
+float xpbd_check_kernel(Project_Kernel* k, uint32_t seed)
+{
+    enum { CHECK_PARTICLES = 64, CHECK_CONSTRAINTS = 29 };
+    float x[2][CHECK_PARTICLES], y[2][CHECK_PARTICLES], inv_mass[CHECK_PARTICLES];
+    int32_t a[CHECK_CONSTRAINTS], b[CHECK_CONSTRAINTS], iterations[CHECK_CONSTRAINTS], kind[CHECK_CONSTRAINTS];
+    float rest[CHECK_CONSTRAINTS], compliance[CHECK_CONSTRAINTS], lambda[2][CHECK_CONSTRAINTS];
+    int32_t order[CHECK_PARTICLES];
+
+    uint32_t s = seed;
+    for (int i = 0; i < CHECK_PARTICLES; i++) {
+        x[0][i] = x[1][i] = check_random(&s) * 400.0f;
+        y[0][i] = y[1][i] = check_random(&s) * 400.0f;
+        inv_mass[i] = check_random(&s) < 0.2f ? 0.0f : 1.0f;
+        order[i] = i;
+    }
+    // A shuffle, paired off, gives a colour with no shared particle.
+    for (int i = CHECK_PARTICLES - 1; i > 0; i--) {
+        int j = (int)(check_random(&s) * (float)(i + 1));
+        int32_t t = order[i];
+        order[i] = order[j];
+        order[j] = t;
+    }
+    for (int i = 0; i < CHECK_CONSTRAINTS; i++) {
+        a[i] = order[2 * i];
+        b[i] = order[2 * i + 1];
+        rest[i] = check_random(&s) * 300.0f;
+        compliance[i] = check_random(&s) < 0.5f ? 0.0f : check_random(&s) * 0.01f;
+        lambda[0][i] = lambda[1][i] = check_random(&s) * 2.0f - 1.0f;
+        iterations[i] = (int32_t)(check_random(&s) * 4.0f);
+        kind[i] = check_random(&s) < 0.5f ? XPBD_EQUAL : XPBD_MIN;
+    }
+    int iteration = (int)(check_random(&s) * 3.0f);
+    float inv_h2 = 1.0f / (0.25f + check_random(&s));
+
+    for (int r = 0; r < 2; r++) {
+        Particles p = {.x = x[r], .y = y[r], .inv_mass = inv_mass};
+        Constraints c = {.a = a, .b = b, .rest = rest, .compliance = compliance, .lambda = lambda[r],
+            .iterations = iterations, .kind = kind, .count = CHECK_CONSTRAINTS};
+        (r == 0 ? project_color_scalar : k)(&p, &c, 0, CHECK_CONSTRAINTS, iteration, inv_h2);
+    }
+    float diff = 0.0f;
+    for (int i = 0; i < CHECK_PARTICLES; i++) diff = fmaxf(diff, fmaxf(fabsf(x[0][i] - x[1][i]), fabsf(y[0][i] - y[1][i])));
+    for (int i = 0; i < CHECK_CONSTRAINTS; i++) diff = fmaxf(diff, fabsf(lambda[0][i] - lambda[1][i]));
+    return diff;
+}
+
+static Leg_Frame leg_frame(const Leg_Points* lp, const Leg_Element* l)
+{
+    return (Leg_Frame) {
+        .origin = lp->top_right,
+        .u = Vector2Scale(Vector2Subtract(lp->top_left, lp->top_right), 1.0f / l->shape.width),
+        .v = Vector2Scale(Vector2Subtract(lp->bot_right, lp->top_right), 1.0f / l->shape.height),
+    };
+}
+
+static Vector2 to_leg(const Leg_Frame* f, Vector2 d)
+{
+    return (Vector2) {Vector2DotProduct(d, f->u), Vector2DotProduct(d, f->v)};
+}
+
+static Vector2 from_leg(const Leg_Frame* f, Vector2 d)
+{
+    return Vector2Add(Vector2Scale(f->u, d.x), Vector2Scale(f->v, d.y));
+}
+
+// Closest point on a leg's box to q, and the outward normal there. Points
+// inside the box are pushed out through the nearest face.
+static float leg_closest(const Leg_Frame* f, const Leg_Element* l, Vector2 q, Vector2* point, Vector2* normal)
+{
+    Vector2 rel = to_leg(f, Vector2Subtract(q, f->origin));
+    float s = rel.x, t = rel.y;
+    float sc = Clamp(s, 0.0f, l->shape.width);
+    float tc = Clamp(t, 0.0f, l->shape.height);
+
+    if (s == sc && t == tc) {
+        float face[4] = {s, l->shape.width - s, t, l->shape.height - t};
+        Vector2 dir[4] = {Vector2Negate(f->u), f->u, Vector2Negate(f->v), f->v};
+        int best = 0;
+        for (int k = 1; k < 4; k++) if (face[k] < face[best]) best = k;
+        *normal = dir[best];
+        *point = Vector2Add(q, Vector2Scale(dir[best], face[best]));
+        return -face[best];
+    }
+    *point = Vector2Add(f->origin, from_leg(f, (Vector2) {sc, tc}));
+    Vector2 d = Vector2Subtract(q, *point);
+    float dist = Vector2Length(d);
+    *normal = dist > 1e-6f ? Vector2Scale(d, 1.0f / dist) : Vector2Negate(f->v);
+    return dist;
+}
+
+// Candidate legs come from the leg tree. Balls are visited in order and
+// each ball's candidates are sorted, so contacts come out sorted by key and
+// merge against the manifold in one pass.
+static void find_leg_contacts(World* w, const Particles* p, int first_ball, Leg_Contacts* lc)
+{
+    int candidates[XPBD_MAX_LEG_CANDIDATES];
+    const Leg_Manifold* m = &w->leg_contacts;
+    int cached = 0;
+    lc->count = 0;
+    if (w->leg_tree.leg_count != w->leg_count) bvh_rebuild(&w->leg_tree, w);
+    for (int bi = 0; bi < w->ball_count; bi++) {
+        if (w->events.airborne[bi]) continue;
+        int pi = first_ball + bi;
+        Vector2 q = {p->x[pi], p->y[pi]};
+        float reach = w->balls[bi].radius + XPBD_CONTACT_MARGIN;
+        int n = bvh_query(&w->leg_tree, q.x - reach, q.y - reach, q.x + reach, q.y + reach,
+            candidates, XPBD_MAX_LEG_CANDIDATES);
+        if (n > XPBD_MAX_LEG_CANDIDATES) n = XPBD_MAX_LEG_CANDIDATES;
+        for (int a = 1; a < n; a++) {
+            int leg = candidates[a], k = a;
+            for (; k > 0 && candidates[k - 1] > leg; k--) candidates[k] = candidates[k - 1];
+            candidates[k] = leg;
+        }
+        int found = 0;
+        for (int c = 0; c < n && found < XPBD_MAX_LEG_CONTACTS; c++) {
+            int i = candidates[c];
+            // Characters out of reach of every ball are left to animation.
+            if (w->lod.tier[i / LEG_COUNT] == LOD_ANIM) continue;
+            Leg_Frame f = leg_frame(&w->leg_points[i], &w->legs[i]);
+            Vector2 point, normal;
+            float separation = leg_closest(&f, &w->legs[i], q, &point, &normal);
+            if (separation > reach) continue;
+
+            uint64_t key = (uint64_t)bi << 32 | (uint32_t)i;
+            float impulse = 0.0f;
+            while (cached < m->count && m->key[cached] < key) cached++;
+            if (cached < m->count && m->key[cached] == key) {
+                impulse = m->impulse[cached];
+                // Still overlapping: keep pushing out through the same face.
+                if (separation < 0.0f) {
+                    point = Vector2Add(f.origin, from_leg(&f, m->point[cached]));
+                    normal = from_leg(&f, m->normal[cached]);
+                }
+            }
+            int k = lc->count++;
+            lc->key[k] = key;
+            lc->ball[k] = pi;
+            lc->point[k] = point;
+            lc->normal[k] = normal;
+            lc->impulse[k] = impulse;
+            found++;
+        }
+    }
+}
+
+// Each contact keeps the total push it has applied this step, clamped so it
+// never pulls; starting from last step's push is the warm start.
+static void warm_start_leg_contacts(Particles* p, const Leg_Contacts* lc)
+{
+    for (int i = 0; i < lc->count; i++) {
+        int pi = lc->ball[i];
+        p->x[pi] += lc->impulse[i] * lc->normal[i].x;
+        p->y[pi] += lc->impulse[i] * lc->normal[i].y;
+    }
+}
+
+static void project_leg_contacts(Particles* p, Leg_Contacts* lc, const World* w, int first_ball)
+{
+    for (int i = 0; i < lc->count; i++) {
+        int pi = lc->ball[i];
+        Vector2 n = lc->normal[i];
+        float C = (p->x[pi] - lc->point[i].x) * n.x + (p->y[pi] - lc->point[i].y) * n.y
+            - w->balls[pi - first_ball].radius;
+        float impulse = fmaxf(lc->impulse[i] - C, 0.0f);
+        float dl = impulse - lc->impulse[i];
+        lc->impulse[i] = impulse;
+        p->x[pi] += dl * n.x;
+        p->y[pi] += dl * n.y;
+    }
+}
+
+static void store_leg_contacts(World* w, const Leg_Contacts* lc)
+{
+    Leg_Manifold* m = &w->leg_contacts;
+    for (int i = 0; i < lc->count; i++) {
+        int leg = (int)(lc->key[i] & 0xffffffffu);
+        Leg_Frame f = leg_frame(&w->leg_points[leg], &w->legs[leg]);
+        m->key[i] = lc->key[i];
+        m->point[i] = to_leg(&f, Vector2Subtract(lc->point[i], f.origin));
+        m->normal[i] = to_leg(&f, lc->normal[i]);
+        m->impulse[i] = lc->impulse[i];
+    }
+    m->count = lc->count;
+}
+
+// One solver pass. Driven characters get their joints solved towards their
+// targets and their legs rotated to match (through the IK blend layer);
+// balls are integrated, collided with each other and pushed out of legs.
+// frame_fraction is the substep length in frames, matching the per-frame
+// ball velocity.
+void xpbd_step(World* w, float dt, float frame_fraction)
+{
+    Xpbd_Solver* s = &w->xpbd;
+    const float h = frame_fraction;
+    const float inv_h2 = 1.0f / (h * h);
+    const float gravity = GRAVITY * dt;
+    int driven = s->driven_count;
+    int first_ball = driven * PARTICLES_PER_CHARACTER;
+    int particle_count = first_ball + w->ball_count;
+    int capacity = driven * CONSTRAINTS_PER_CHARACTER;
+    s->driven_count = 0;
+    s->ik_solves += (uint64_t)driven;
+    if (particle_count == 0) return;
+
+    size_t mark = arena_mark(w->scratch);
+    Particles p = {
+        .x = ARENA_PUSH_ARRAY(w->scratch, float, particle_count),
+        .y = ARENA_PUSH_ARRAY(w->scratch, float, particle_count),
+        .inv_mass = ARENA_PUSH_ARRAY(w->scratch, float, particle_count),
+    };
+    Vector2* advance = ARENA_PUSH_ARRAY(w->scratch, Vector2, w->ball_count + 1);
+    uint32_t* used = ARENA_PUSH_ARRAY(w->scratch, uint32_t, particle_count);
+    int max_leg_contacts = w->ball_count * XPBD_MAX_LEG_CONTACTS + 1;
+    Leg_Contacts lc = {
+        .key = ARENA_PUSH_ARRAY(w->scratch, uint64_t, max_leg_contacts),
+        .ball = ARENA_PUSH_ARRAY(w->scratch, int32_t, max_leg_contacts),
+        .point = ARENA_PUSH_ARRAY(w->scratch, Vector2, max_leg_contacts),
+        .normal = ARENA_PUSH_ARRAY(w->scratch, Vector2, max_leg_contacts),
+        .impulse = ARENA_PUSH_ARRAY(w->scratch, float, max_leg_contacts),
+    };
+    Constraints pending, c;
+    if (p.x == NULL || p.y == NULL || p.inv_mass == NULL || advance == NULL || used == NULL
+        || lc.key == NULL || lc.ball == NULL || lc.point == NULL || lc.normal == NULL || lc.impulse == NULL
+        || !push_constraints(w->scratch, &pending, capacity + 1) || !push_constraints(w->scratch, &c, capacity + 1)) {
+        arena_rewind(w->scratch, mark);
+        return;
+    }
+
+    // Driven characters: four joints, hip pinned, plus a pinned target.
+    int max_iterations = 0;
+    for (int d = 0; d < driven; d++) {
+        const Character* ch = &w->characters[s->driven[d]];
+        int base = d * PARTICLES_PER_CHARACTER;
+        for (int j = 0; j < JOINT_COUNT; j++) {
+            p.x[base + j] = w->joints[ch->first_joint + j].centre_position.x;
+            p.y[base + j] = w->joints[ch->first_joint + j].centre_position.y;
+            p.inv_mass[base + j] = j == 0 ? 0.0f : 1.0f;
+        }
+        p.x[base + JOINT_COUNT] = s->target[d].x;
+        p.y[base + JOINT_COUNT] = s->target[d].y;
+        p.inv_mass[base + JOINT_COUNT] = 0.0f;
+
+        int iterations = s->iterations[d];
+        if (iterations > max_iterations) max_iterations = iterations;
+        s->ik_iterations += (uint64_t)iterations;
+        float length[JOINT_COUNT - 1];
+        for (int j = 0; j < JOINT_COUNT - 1; j++) {
+            const Leg_Element* l = &w->legs[ch->first_leg + j];
+            length[j] = Vector2Length((Vector2) {l->shape.width, l->shape.height});
+            add_constraint(&pending, base + j, base + j + 1, length[j], 0.0f, iterations, XPBD_EQUAL);
+        }
+        for (int j = 0; j < JOINT_COUNT - 2; j++) {
+            float rest = XPBD_BEND_MIN_FRACTION * (length[j] + length[j + 1]);
+            add_constraint(&pending, base + j, base + j + 2, rest, 0.0f, iterations, XPBD_MIN);
+        }
+        add_constraint(&pending, base + JOINT_COUNT - 1, base + JOINT_COUNT, 0.0f,
+            XPBD_TARGET_COMPLIANCE, iterations, XPBD_EQUAL);
+    }
+
+    // Balls: gravity, then ball-ball and bounds impulses on the velocities,
+    // then explicit prediction; leg contacts are found at the predicted spot.
+    // Balls in event driven flight are moved by event.h instead.
+    for (int bi = 0; bi < w->ball_count; bi++) {
+        if (!w->events.airborne[bi]) w->balls[bi].velocity.y += gravity * h;
+    }
+    contact_solve_balls(w, h, advance);
+    for (int bi = 0; bi < w->ball_count; bi++) {
+        Ball* b = &w->balls[bi];
+        int pi = first_ball + bi;
+        advance[bi] = Vector2Add(b->centre_position, Vector2Scale(advance[bi], h));
+        p.x[pi] = advance[bi].x;
+        p.y[pi] = advance[bi].y;
+        p.inv_mass[pi] = 1.0f;
+    }
+    find_leg_contacts(w, &p, first_ball, &lc);
+    warm_start_leg_contacts(&p, &lc);
+    if (w->ball_count > 0 && max_iterations < XPBD_CONTACT_ITERATIONS) max_iterations = XPBD_CONTACT_ITERATIONS;
+
+    int color_count[XPBD_MAX_COLORS];
+    int start[XPBD_MAX_COLORS + 1];
+    int colors = color_constraints(&pending, &p, used, particle_count, color_count);
+    sort_by_color(&pending, &c, color_count, start);
+
+    for (int it = 0; it < max_iterations; it++) {
+        for (int k = 0; k < colors; k++) {
+            if (k == XPBD_MAX_COLORS - 1) {
+                for (int i = start[k]; i < start[k + 1]; i++) project_distance(&p, &c, i, it, inv_h2);
+            } else {
+                kernels.project_color(&p, &c, start[k], start[k + 1], it, inv_h2);
+            }
+        }
+        if (it < XPBD_CONTACT_ITERATIONS) project_leg_contacts(&p, &lc, w, first_ball);
+    }
+
+    for (int d = 0; d < driven; d++) {
+        const Character* ch = &w->characters[s->driven[d]];
+        int base = d * PARTICLES_PER_CHARACTER;
+        for (int j = 1; j < JOINT_COUNT; j++) {
+            w->joints[ch->first_joint + j].centre_position = (Vector2) {p.x[base + j], p.y[base + j]};
+        }
+        rotate_legs(w, s->driven[d]);
+    }
+    for (int bi = 0; bi < w->ball_count; bi++) {
+        if (w->events.airborne[bi]) continue;
+        Ball* b = &w->balls[bi];
+        int pi = first_ball + bi;
+        // Whatever the legs pushed the ball by becomes velocity.
+        b->centre_position = (Vector2) {p.x[pi], p.y[pi]};
+        b->velocity = Vector2Add(b->velocity, Vector2Scale(Vector2Subtract(b->centre_position, advance[bi]), 1.0f / h));
+        b->hit = false;
+    }
+    for (int i = 0; i < lc.count; i++) w->balls[lc.ball[i] - first_ball].hit = true;
+    store_leg_contacts(w, &lc);
+
+    arena_rewind(w->scratch, mark);
+}
@@ -0,0 +1,97 @@
+#ifndef XPBD_H
+#define XPBD_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "arena.h"
+#include "dispatch.h"
+
+// Unified position-based solver for leg IK and ball physics. Once per
+// substep xpbd_step gathers the joints of every driven character, a fixed
+// target point per character and every ball into one particle set and
+// projects all constraints on it with XPBD:
+//
+//     segment    |x_i - x_i+1| == leg length                  stiff
+//     bend       |x_i - x_i+2| >= XPBD_BEND_MIN_FRACTION * reach
+//     target     |x_tip - target| == 0                        XPBD_TARGET_COMPLIANCE
+//     ball/leg   n . (x_ball - p) >= r     p, n: closest point on the leg box
+//
+// Candidate legs for each ball come from the leg tree in bvh.h; a ball
+// buried in more than XPBD_MAX_LEG_CANDIDATES leg boxes only sees the first.
+// Ball-ball and bounds contacts are resolved on the velocities just before
+// the balls are predicted, by the impulse solver in contact.h.
+//
+// Ball/leg contacts persist across steps in a Leg_Manifold keyed by the
+// (ball, leg) pair. Each entry keeps the contact point and normal in the
+// leg's own frame, plus the push the contact applied last step. A pair
+// found again starts from that push, and an overlapping pair keeps its
+// cached face, so a ball resting on a foot neither sinks in and climbs
+// back out each step nor flips between faces. Pairs that drift out of
+// reach are simply not found again, so they drop out when the cache is
+// rewritten.
+//
+// Hips and targets have zero inverse mass and legs are kinematic to the
+// balls, so a moving leg pushes a ball and the push becomes its velocity.
+// Distance constraints are greedily graph-coloured so no two in a colour
+// share a movable particle, which lets each colour be projected four or
+// eight at a time in SIMD lanes; anything past XPBD_MAX_COLORS - 1 colours lands in a
+// last colour that is projected one by one. Each constraint carries its own
+// iteration count, so LOD tiers can stop early inside the shared solve.
+
+#define XPBD_MAX_COLORS 16
+#define XPBD_TARGET_COMPLIANCE 0.001f
+#define XPBD_BEND_MIN_FRACTION 0.3f
+#define XPBD_CONTACT_ITERATIONS 4
+#define XPBD_CONTACT_MARGIN 4.0f
+#define XPBD_MAX_LEG_CONTACTS 8
+#define XPBD_MAX_LEG_CANDIDATES 1024
+
+typedef enum xpbd_kind {
+    XPBD_EQUAL,
+    XPBD_MIN,
+} Xpbd_Kind;
+
+// Characters whose tip is pulled towards a target on the next xpbd_step.
+// ik_solves and ik_iterations count the chains solved and the iterations
+// they ran since the level was loaded. frame_driven counts the distinct
+// characters driven since xpbd_begin_frame; driven_frame[c] is the frame c
+// was last counted in.
+typedef struct xpbd_solver {
+    int* driven;
+    Vector2* target;
+    int* iterations;
+    uint32_t* driven_frame;
+    int driven_count;
+    int max_driven;
+    uint32_t frame;
+    int frame_driven;
+    uint64_t ik_solves;
+    uint64_t ik_iterations;
+} Xpbd_Solver;
+
+// Last step's ball/leg contacts, sorted by key = ball << 32 | leg. point
+// and normal are in the leg frame: x along the width from the top-right
+// corner, y along the height.
+typedef struct leg_manifold {
+    uint64_t* key;
+    Vector2* point;
+    Vector2* normal;
+    float* impulse;
+    int count;
+    int capacity;
+} Leg_Manifold;
+
+struct world;
+
+extern Project_Kernel* const xpbd_project_kernels[CPU_LEVEL_COUNT];
+
+size_t xpbd_memory_size(int character_count);
+bool xpbd_init(Xpbd_Solver* s, Arena* level, int character_count);
+size_t leg_manifold_memory_size(int max_balls);
+bool leg_manifold_init(Leg_Manifold* m, Arena* level, int max_balls);
+void xpbd_begin_frame(Xpbd_Solver* s);
+void xpbd_drive(struct world* w, int character, Vector2 target, int iterations);
+float xpbd_check_kernel(Project_Kernel* k, uint32_t seed);
+void xpbd_step(struct world* w, float dt, float frame_fraction);
+
+#endif
@@ -0,0 +1,88 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "telemetry.h"
+
+// Samples the segment a sim started with --telemetry publishes and prints a
+// line per sample: frame rate and frame-time percentiles over the interval,
+// the heaviest profiler zones of the last frame, body counts and IK work.
+// Reading never blocks the sim, so any rate is fine.
+//
+//     telemetry_view [samples per second]
+
+#define VIEW_DEFAULT_RATE 2.0
+#define VIEW_TOP_ZONES 3
+
+// Frames recorded between two samples of the cumulative histogram.
+static void hist_since(Histogram* out, const Histogram* now, const Histogram* then)
+{
+    out->count = now->count - then->count;
+    out->sum = now->sum - then->sum;
+    out->min = now->min;
+    out->max = now->max;
+    for (int i = 0; i < HIST_BUCKET_COUNT; i++) out->buckets[i] = now->buckets[i] - then->buckets[i];
+}
+
+static void print_top_zones(const Telemetry_Segment* s, const Telemetry_Frame* f)
+{
+    bool shown[PROF_ZONE_COUNT] = {0};
+    // The frame zone encloses the others.
+    shown[PROF_FRAME] = true;
+    for (int k = 0; k < VIEW_TOP_ZONES; k++) {
+        int best = -1;
+        for (int i = 0; i < PROF_ZONE_COUNT; i++) {
+            if (!shown[i] && f->zone_ns[i] > 0 && (best == -1 || f->zone_ns[i] > f->zone_ns[best])) best = i;
+        }
+        if (best == -1) return;
+        shown[best] = true;
+        printf(" %s %.3f", s->zone_names[best], (double)f->zone_ns[best] * 1e-6);
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    double rate = argc > 1 ? atof(argv[1]) : VIEW_DEFAULT_RATE;
+    if (rate <= 0.0) rate = VIEW_DEFAULT_RATE;
+    uint64_t period = (uint64_t)(1e9 / rate);
+
+    Platform_Mapping m;
+    while (!platform_open_shared(TELEMETRY_NAME, &m)) {
+        printf("telemetry: waiting for %s\n", TELEMETRY_NAME);
+        platform_sleep_ns(1000000000ull);
+    }
+    const Telemetry_Segment* s = m.data;
+    if (m.size < sizeof(Telemetry_Segment) || __atomic_load_n(&s->magic, __ATOMIC_ACQUIRE) != TELEMETRY_MAGIC
+        || s->version != TELEMETRY_VERSION || s->size != sizeof(Telemetry_Segment)) {
+        printf("telemetry: %s is not a version %d segment\n", TELEMETRY_NAME, TELEMETRY_VERSION);
+        return 1;
+    }
+
+    static Telemetry_Frame now, then;
+    static Histogram interval;
+    if (!telemetry_read(s, &then)) then = (Telemetry_Frame) {0};
+    for (;;) {
+        platform_sleep_ns(period);
+        if (!telemetry_read(s, &now)) {
+            printf("telemetry: no consistent frame, the writer is too fast for this sample\n");
+            continue;
+        }
+        if (now.closed) {
+            printf("telemetry: sim exited after %llu frames\n", (unsigned long long)now.frame);
+            break;
+        }
+        uint64_t frames = now.frame - then.frame;
+        double seconds = (double)(now.time_ns - then.time_ns) * 1e-9;
+        hist_since(&interval, &now.frame_ns, &then.frame_ns);
+        printf("frame %llu: %.0f fps, ms p50 %.3f p99 %.3f |",
+            (unsigned long long)now.frame, frames > 0 && seconds > 0.0 ? (double)frames / seconds : 0.0,
+            (double)hist_percentile(&interval, 50.0) * 1e-6, (double)hist_percentile(&interval, 99.0) * 1e-6);
+        print_top_zones(s, &now);
+        printf(" | balls %d awake %d airborne %d, chars %d animated %d driven %d, ik it/frame %.1f\n",
+            now.balls, now.awake_balls, now.airborne_balls, now.characters, now.animated_characters,
+            now.driven_characters, frames > 0 ? (double)(now.ik_iterations_total - then.ik_iterations_total) / (double)frames : 0.0);
+        fflush(stdout);
+        then = now;
+    }
+    platform_unmap_file(&m);
+    return 0;
+}